@@ -0,0 +1,95 @@
+#include <gflags/gflags.h>
+
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "replicated-splinterdb/client/read_policy.h"
+
+DEFINE_uint64(servers, 5, "The number of servers in the read policy");
+DEFINE_string(tokens, "3,64,1024,4096",
+              "Comma-separated numbers of tokens per server to try");
+DEFINE_uint64(keys, 100000, "The number of distinct keys to look up");
+DEFINE_uint64(keysize, 24, "The size of each key (in bytes)");
+DEFINE_uint64(rounds, 20, "The number of passes over the keys per policy");
+
+using replicated_splinterdb::hash_read_policy;
+using replicated_splinterdb::latency_aware_read_policy;
+using replicated_splinterdb::random_token_read_policy;
+using replicated_splinterdb::read_policy;
+using replicated_splinterdb::round_robin_read_policy;
+
+static std::vector<size_t> parse_tokens(const std::string& list) {
+    std::vector<size_t> tokens;
+    size_t pos = 0;
+    while (pos < list.size()) {
+        size_t end = list.find(',', pos);
+        if (end == std::string::npos) {
+            end = list.size();
+        }
+        tokens.push_back(std::stoul(list.substr(pos, end - pos)));
+        pos = end + 1;
+    }
+    return tokens;
+}
+
+static void run(const std::string& name, read_policy& policy,
+                const std::vector<std::string>& keys) {
+    // Keep the picks observable so the loop is not optimized away.
+    int64_t checksum = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (uint64_t r = 0; r < FLAGS_rounds; ++r) {
+        for (const auto& key : keys) {
+            checksum += policy.next_server(key);
+        }
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed);
+    double lookups = static_cast<double>(FLAGS_rounds * keys.size());
+    std::cout << name << ": "
+              << static_cast<double>(ns.count()) / lookups << " ns/lookup"
+              << " (checksum " << checksum << ")" << std::endl;
+}
+
+int main(int argc, char** argv) {
+    gflags::SetUsageMessage("Measure the cost of picking a server per read");
+    gflags::ParseCommandLineFlags(&argc, &argv, true);
+
+    std::vector<int32_t> server_ids;
+    for (uint64_t i = 1; i <= FLAGS_servers; ++i) {
+        server_ids.push_back(static_cast<int32_t>(i));
+    }
+
+    std::mt19937 rng{42};
+    std::uniform_int_distribution<int> byte('a', 'z');
+    std::vector<std::string> keys(FLAGS_keys);
+    for (auto& key : keys) {
+        key.resize(FLAGS_keysize);
+        for (auto& c : key) {
+            c = static_cast<char>(byte(rng));
+        }
+    }
+
+    round_robin_read_policy round_robin{server_ids};
+    run("round_robin", round_robin, keys);
+
+    for (size_t num_tokens : parse_tokens(FLAGS_tokens)) {
+        std::string suffix = " (" + std::to_string(num_tokens) + " tokens)";
+
+        hash_read_policy hash{server_ids, num_tokens};
+        run("hash" + suffix, hash, keys);
+
+        random_token_read_policy random_token{server_ids, num_tokens};
+        run("random_token" + suffix, random_token, keys);
+
+        latency_aware_read_policy latency_aware{server_ids, num_tokens};
+        run("latency_aware" + suffix, latency_aware, keys);
+    }
+
+    return 0;
+}
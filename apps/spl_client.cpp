@@ -13,8 +13,11 @@ DEFINE_string(e, "",
 #define CLM_GREEN "\033[32m"
 #define CLM_END "\033[0m"
 
+using replicated_splinterdb::read_consistency;
 using replicated_splinterdb::rpc_cluster_endpoints;
+using replicated_splinterdb::rpc_multi_read_result;
 using replicated_splinterdb::rpc_mutation_result;
+using replicated_splinterdb::rpc_scan_result;
 using replicated_splinterdb::rpc_read_result;
 using replicated_splinterdb::rpc_server_info;
 
@@ -70,7 +73,20 @@ static bool handle_command(replicated_splinterdb::client& client,
         auto res = client.del(tokens[1]);
         return handle_mutation_result(std::move(res));
     } else if (cmd == "get" && tokens.size() >= 2) {
-        rpc_read_result res{client.get(tokens[1])};
+        read_consistency consistency = read_consistency::local;
+        if (tokens.size() >= 3) {
+            if (tokens[2] == "lease") {
+                consistency = read_consistency::lease;
+            } else if (tokens[2] == "read_index") {
+                consistency = read_consistency::read_index;
+            } else if (tokens[2] != "local") {
+                std::cout << "ERROR: unknown consistency \"" << tokens[2]
+                          << "\"" << std::endl;
+                return false;
+            }
+        }
+
+        rpc_read_result res{client.get(tokens[1], std::nullopt, consistency)};
 
         if (res.rc() == 0) {
             std::cout << "value: " << res.value() << std::endl;
@@ -79,6 +95,39 @@ static bool handle_command(replicated_splinterdb::client& client,
             std::cout << "get failed, rc=" << res.rc() << std::endl;
             return false;
         }
+    } else if (cmd == "mget" && tokens.size() >= 2) {
+        std::vector<std::string> keys(tokens.begin() + 1, tokens.end());
+        rpc_multi_read_result res{client.multi_get(keys)};
+
+        bool all_found = true;
+        for (size_t i = 0; i < keys.size(); ++i) {
+            if (res.rc(i) == 0) {
+                std::cout << keys[i] << ": " << res.value(i) << std::endl;
+            } else {
+                std::cout << keys[i] << ": get failed, rc=" << res.rc(i)
+                          << std::endl;
+                all_found = false;
+            }
+        }
+        return all_found;
+    } else if ((cmd == "scan" && tokens.size() >= 3) ||
+               (cmd == "prefix" && tokens.size() >= 2)) {
+        auto print_page = [](const rpc_scan_result& page) {
+            for (size_t i = 0; i < page.size(); ++i) {
+                std::cout << page.keys()[i] << ": " << page.values()[i]
+                          << std::endl;
+            }
+            return true;
+        };
+
+        int32_t rc = cmd == "scan"
+                         ? client.scan(tokens[1], tokens[2], print_page)
+                         : client.prefix_scan(tokens[1], print_page);
+        if (rc != 0) {
+            std::cout << "scan failed, rc=" << rc << std::endl;
+            return false;
+        }
+        return true;
     } else if (cmd == "ls") {
         rpc_cluster_endpoints srvs = client.get_all_servers();
         int32_t leader_id = client.get_leader_id();
@@ -93,6 +142,12 @@ static bool handle_command(replicated_splinterdb::client& client,
             std::cout << s.id() << "  : " << s.endpoint() << extra << std::endl;
         }
 
+        return true;
+    } else if (cmd == "hotkeys") {
+        size_t limit = tokens.size() >= 2 ? std::stoul(tokens[1]) : 10;
+        for (const auto& [key, count] : client.get_hot_keys(limit)) {
+            std::cout << key << " : " << count << std::endl;
+        }
         return true;
     } else if (cmd == "dumpcache" && tokens.size() >= 2) {
         client.trigger_cache_dumps(tokens[1]);
@@ -105,8 +160,12 @@ static bool handle_command(replicated_splinterdb::client& client,
         std::cout << "  put <key> <value>" << std::endl;
         std::cout << "  update <key> <value>" << std::endl;
         std::cout << "  delete <key>" << std::endl;
-        std::cout << "  get <key>" << std::endl;
+        std::cout << "  get <key> [local|lease|read_index]" << std::endl;
+        std::cout << "  mget <key> [<key> ...]" << std::endl;
+        std::cout << "  scan <start key> <end key>" << std::endl;
+        std::cout << "  prefix <prefix>" << std::endl;
         std::cout << "  ls" << std::endl;
+        std::cout << "  hotkeys [count]" << std::endl;
         std::cout << "  dumpcache <directory>" << std::endl;
         std::cout << "  clearcache" << std::endl;
         std::cout << "  help" << std::endl;
@@ -46,6 +46,11 @@ DEFINE_string(seed, "",
               "this server to the cluster. If empty, this server will start a "
               "new cluster.");
 DEFINE_int64(nthreads, 40, "The number of threads to use for RPC handling");
+DEFINE_uint64(lookupthreads, 4,
+              "The number of threads that multi-key reads fan out to");
+DEFINE_uint64(hotkeys, 256,
+              "The number of most looked-up keys to track for clients' read "
+              "routing (0 to disable)");
 
 DEFINE_validator(raftport, &validate_port);
 DEFINE_validator(clientport, &validate_port);
@@ -61,6 +66,38 @@ DEFINE_uint64(
     maxkeysize, 100,
     "The maximum size of a key (in bytes) that can be stored in SplinterDB");
 
+// Raft snapshot flags
+DEFINE_int32(snapshotdistance, 0,
+             "The number of logs between snapshots. Snapshots are disabled "
+             "if 0, and every restart or new replica replays the full log");
+DEFINE_int32(reservedlogs, 100000,
+             "The number of logs kept behind the last snapshot for lagging "
+             "followers to catch up from");
+
+// Raft log store flags
+DEFINE_string(logstore, "segmented",
+              "The Raft log store to use: \"segmented\" (on disk) or "
+              "\"memory\"");
+DEFINE_string(logdir, "",
+              "The directory holding the Raft log segments. Defaults to "
+              "raft-log-<serverid>");
+DEFINE_string(statedir, "",
+              "The directory holding the Raft term, vote and cluster "
+              "configuration. Defaults to raft-state-<serverid>");
+DEFINE_uint64(logsegmentsize, 64,
+              "The size of a Raft log segment file (in MB)");
+DEFINE_string(logfsync, "group_commit",
+              "When to fsync the Raft log: \"never\", \"on_flush\", "
+              "\"always\" or \"group_commit\"");
+DEFINE_string(returnmethod, "blocking",
+              "How Raft returns the outcome of appended logs: \"blocking\" "
+              "or \"async\"");
+DEFINE_uint64(logcompressthreshold, 1024,
+              "Values of at least this many bytes are compressed in Raft log "
+              "entries. Compression is disabled if 0");
+
+using replicated_splinterdb::log_fsync_policy;
+using replicated_splinterdb::log_store_type;
 using replicated_splinterdb::LogLevel;
 using replicated_splinterdb::replica_config;
 using replicated_splinterdb::server;
@@ -141,6 +178,55 @@ int main(int argc, char** argv) {
     cfg.raft_port_ = raft_port;
     cfg.client_port_ = client_port;
 
+    cfg.lookup_threads_ = FLAGS_lookupthreads;
+    cfg.hot_key_capacity_ = FLAGS_hotkeys;
+
+    cfg.snapshot_frequency_ = FLAGS_snapshotdistance;
+    cfg.reserved_log_items_ = FLAGS_reservedlogs;
+
+    if (FLAGS_logstore == "memory") {
+        cfg.log_store_type_ = log_store_type::in_memory;
+    } else if (FLAGS_logstore == "segmented") {
+        cfg.log_store_type_ = log_store_type::segmented;
+    } else {
+        std::cerr << "ERROR: unknown log store \"" << FLAGS_logstore << "\""
+                  << std::endl;
+        return 1;
+    }
+
+    if (!FLAGS_logdir.empty()) {
+        cfg.log_store_dir_ = FLAGS_logdir;
+    }
+    if (!FLAGS_statedir.empty()) {
+        cfg.state_dir_ = FLAGS_statedir;
+    }
+    cfg.log_segment_size_ = FLAGS_logsegmentsize * 1024 * 1024;
+    cfg.log_compression_threshold_ = FLAGS_logcompressthreshold;
+
+    if (FLAGS_logfsync == "never") {
+        cfg.log_fsync_policy_ = log_fsync_policy::never;
+    } else if (FLAGS_logfsync == "on_flush") {
+        cfg.log_fsync_policy_ = log_fsync_policy::on_flush;
+    } else if (FLAGS_logfsync == "always") {
+        cfg.log_fsync_policy_ = log_fsync_policy::always;
+    } else if (FLAGS_logfsync == "group_commit") {
+        cfg.log_fsync_policy_ = log_fsync_policy::group_commit;
+    } else {
+        std::cerr << "ERROR: unknown fsync policy \"" << FLAGS_logfsync
+                  << "\"" << std::endl;
+        return 1;
+    }
+
+    if (FLAGS_returnmethod == "blocking") {
+        cfg.set_return_method(nuraft::raft_params::blocking);
+    } else if (FLAGS_returnmethod == "async") {
+        cfg.set_return_method(nuraft::raft_params::async_handler);
+    } else {
+        std::cerr << "ERROR: unknown return method \"" << FLAGS_returnmethod
+                  << "\"" << std::endl;
+        return 1;
+    }
+
     cfg.log_level_ = LogLevel::TRACE;
     cfg.display_level_ = LogLevel::DISABLED;
 
@@ -148,7 +234,8 @@ int main(int argc, char** argv) {
     std::cout << "Listening for replication RPCs on port " << cfg.raft_port_
               << std::endl;
 
-    if (!FLAGS_seed.empty()) {
+    // A recovered replica is still in the cluster configuration it saved.
+    if (!FLAGS_seed.empty() && !srv.is_recovered()) {
         try_join_cluster(cfg);
     }
 
@@ -1,14 +1,31 @@
 #ifndef REPLICATED_SPLINTERDB_CLIENT_CLIENT_H
 #define REPLICATED_SPLINTERDB_CLIENT_CLIENT_H
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <future>
 #include <map>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
 
+#include "replicated-splinterdb/client/connection_pool.h"
+#include "replicated-splinterdb/client/latency_histogram.h"
 #include "replicated-splinterdb/client/read_policy.h"
 #include "replicated-splinterdb/common/types.h"
 #include "rpc/client.h"
 
 namespace replicated_splinterdb {
 
+/**
+ * Client for a replicated SplinterDB cluster.
+ *
+ * A client can be shared by any number of threads. Requests from different
+ * threads are pipelined over the same per-server connections, and the
+ * `async_*` calls let a single thread keep many requests in flight.
+ */
 class client {
   public:
     client() = delete;
@@ -20,9 +37,100 @@ class client {
     client(const std::string& host, uint16_t port,
            read_policy::algorithm read_algo, size_t rp_num_tokens = 3,
            uint64_t timeout_ms = 10000, uint16_t num_retries = 3,
-           bool print_errors = false);
+           bool print_errors = false, size_t connections_per_server = 4);
 
-    rpc_read_result get(const std::string& key, std::optional<int32_t> server = std::nullopt);
+    ~client();
+
+    /**
+     * Read a key.
+     *
+     * @param key Key to read.
+     * @param server Replica to read from. Chosen by the read policy if
+     *               unset, or the leader for `lease` reads.
+     * @param consistency How up to date the read has to be.
+     * @return The value, or a SplinterDB or READ_RC_* return code.
+     */
+    rpc_read_result get(
+        const std::string& key, std::optional<int32_t> server = std::nullopt,
+        read_consistency consistency = read_consistency::local);
+
+    /**
+     * Hedge the reads `get()` sends by the read policy. If a replica has
+     * not answered within the given percentile of recent read latencies,
+     * the read is sent to a second replica too, and whichever answers first
+     * wins. rpclib cannot cancel a call in flight, so the slower answer is
+     * discarded when it arrives. Lease reads are never hedged, since only
+     * the leader can serve them.
+     *
+     * @param percentile Percentile of read latencies to wait for, in
+     *                   (0, 1), or 0 to stop hedging.
+     * @param min_delay Shortest wait before hedging, so that reads are not
+     *                  doubled while there are few latencies to go by.
+     */
+    void set_hedged_reads(
+        double percentile,
+        std::chrono::microseconds min_delay = std::chrono::milliseconds(1));
+
+    /**
+     * Read several keys, splitting them over replicas by the read policy
+     * and querying those replicas concurrently.
+     *
+     * @param keys Keys to read.
+     * @param consistency How up to date the reads have to be.
+     * @return Values and return codes, in the order of `keys`.
+     */
+    rpc_multi_read_result multi_get(
+        const std::vector<std::string>& keys,
+        read_consistency consistency = read_consistency::local);
+
+    // Called with each page of a scan. Return `false` to stop the scan.
+    using scan_callback = std::function<bool(const rpc_scan_result&)>;
+
+    /**
+     * Read the keys in [start_key, end_key) in order, a page at a time.
+     *
+     * @param start_key First key, or empty to start at the smallest key.
+     * @param end_key Key to stop before, or empty to scan to the end.
+     * @param on_page Called with each page of results.
+     * @param page_size Maximum number of entries per page; 0 lets the
+     *                  server decide.
+     * @param consistency How up to date the reads have to be.
+     * @return 0, or the return code of the page that failed.
+     */
+    int32_t scan(const std::string& start_key, const std::string& end_key,
+                 const scan_callback& on_page, uint32_t page_size = 0,
+                 read_consistency consistency = read_consistency::local);
+
+    // Read every key that starts with `prefix`, like `scan()`.
+    int32_t prefix_scan(
+        const std::string& prefix, const scan_callback& on_page,
+        uint32_t page_size = 0,
+        read_consistency consistency = read_consistency::local);
+
+    /**
+     * Start reading a key from the replica chosen by the read policy.
+     * A lease read that hits a stale leader is retried on the current one
+     * when the result is waited for.
+     *
+     * @param key Key to read.
+     * @param consistency How up to date the read has to be.
+     * @return Future result, decoded by the thread that waits for it.
+     */
+    std::future<rpc_read_result> async_get(
+        const std::string& key,
+        read_consistency consistency = read_consistency::local);
+
+    /**
+     * Start writing a key on the leader. If the leader has changed, the
+     * write is retried like `put()` when the result is waited for.
+     *
+     * @return Future result, decoded by the thread that waits for it.
+     */
+    std::future<rpc_mutation_result> async_put(const std::string& key,
+                                               const std::string& val);
+
+    // Start deleting a key on the leader, like `async_put()`.
+    std::future<rpc_mutation_result> async_del(const std::string& key);
 
     rpc_mutation_result put(const std::string& key, const std::string& val);
 
@@ -30,6 +138,9 @@ class client {
 
     rpc_mutation_result del(const std::string& key);
 
+    // Replicate all of the batch's mutations through a single log entry.
+    rpc_mutation_result write_batch(const rpc_write_batch& batch);
+
     void trigger_cache_dumps(const std::string& directory);
 
     void trigger_cache_clear();
@@ -40,20 +151,139 @@ class client {
 
     void set_fixed_key_mapping(std::unordered_map<std::string, size_t>&& m);
 
+    /**
+     * The keys the replicas have looked up most often lately, with their
+     * approximate lookup counts summed over the replicas.
+     *
+     * @param limit Maximum number of keys to return.
+     * @return Keys and counts, hottest first.
+     */
+    std::vector<std::pair<std::string, uint64_t>> get_hot_keys(size_t limit);
+
+    /**
+     * Replace the fixed read policy's mapping with one that spreads the
+     * hottest keys over the replicas by their lookup counts. A key stays
+     * on its current replica unless that replica would get more than its
+     * share, so caches are not needlessly invalidated. Keys outside the
+     * mapping are routed by hash.
+     *
+     * @param num_keys Number of hottest keys to map.
+     * @return `false` if the read policy is not `fixed`.
+     */
+    bool rebalance_fixed_mapping(size_t num_keys = 1024);
+
+    /**
+     * Call `rebalance_fixed_mapping()` from a background thread every
+     * `interval` until the client is destroyed.
+     */
+    void start_rebalancing(std::chrono::milliseconds interval,
+                           size_t num_keys = 1024);
+
+    /**
+     * Fetch the cluster's servers and, if they changed, connect to the new
+     * ones and rebuild the read policy over the current set. With the hash
+     * policy only the keys of added or removed servers move.
+     *
+     * A fixed read policy keeps routing by its original mapping.
+     *
+     * @return `true` if the membership changed.
+     */
+    bool refresh_membership();
+
   private:
-    std::map<int32_t, rpc::client> clients_;
-    std::unique_ptr<read_policy> read_policy_;
+    // Connection pools by server ID. Pools are only ever added, and are
+    // safe to use from several threads.
+    std::map<int32_t, std::unique_ptr<connection_pool>> clients_;
+    // Mutex for the `clients_` map.
+    std::shared_mutex clients_lock_;
+    // Replaced on membership changes. Requests in flight keep reporting to
+    // the policy they were routed by.
+    std::shared_ptr<read_policy> read_policy_;
+    // Mutex for `read_policy_` and `member_ids_`. The policy's state changes
+    // on every pick.
+    std::mutex read_policy_lock_;
+    // Sorted IDs of the servers `read_policy_` routes to.
+    std::vector<int32_t> member_ids_;
     read_policy::algorithm algo_;
-    int32_t leader_id_;
+    const size_t rp_num_tokens_;
+    const uint64_t timeout_ms_;
+    const size_t connections_per_server_;
+    std::atomic<int32_t> leader_id_;
     const uint16_t num_retries_;
     bool print_errors_;
 
-    rpc::client& get_leader_handle();
+    // Latencies of the first replica asked by hedged reads.
+    latency_histogram read_latencies_;
+    // Percentile of `read_latencies_` after which reads are hedged, or 0.
+    std::atomic<double> hedge_percentile_;
+    std::atomic<int64_t> hedge_min_delay_us_;
+
+    // A read sent by `hedged_get()`.
+    struct pending_read;
+    // Where the reads of one hedge report their answers.
+    struct hedge_outcome;
+    // Tasks each waiting for one read of a hedge to be answered. The read
+    // keeps its connection lease and read timer until then, so a loser
+    // still counts as outstanding. Finished tasks are dropped when the next
+    // one starts, and the rest are waited for by the destructor.
+    std::vector<std::future<void>> read_watchers_;
+    // Mutex for `read_watchers_`.
+    std::mutex read_watchers_lock_;
+
+    // Background thread started by `start_rebalancing()`.
+    std::thread rebalancer_;
+    // Mutex for `stop_rebalancer_`.
+    std::mutex rebalancer_lock_;
+    // Signalled when the client is being destroyed.
+    std::condition_variable rebalancer_cv_;
+    bool stop_rebalancer_;
+
+    // Connect to servers not seen before and rebuild the read policy if
+    // the set of servers changed. Returns `true` if it did.
+    bool update_membership(const rpc_cluster_endpoints& srvs);
+
+    // The pools by server ID, for calls that go to every server.
+    std::vector<std::pair<int32_t, connection_pool*>> all_pools();
+
+    std::shared_ptr<read_policy> current_read_policy();
+
+    // A server to send a read to, and the policy that picked it, which the
+    // read reports its latency to.
+    struct read_route {
+        int32_t server_;
+        std::shared_ptr<read_policy> policy_;
+    };
+
+    // Check out a connection to the given server.
+    connection_pool::lease connection(int32_t server_id);
+
+    // Read `key` from `primary`, and also from another replica if
+    // `primary` is slow to answer.
+    rpc_read_result hedged_get(const std::string& key,
+                               const read_route& primary,
+                               read_consistency consistency);
+
+    // Wait for `read` in the background until it is answered or
+    // `deadline` passes, and report the answer to `outcome`.
+    void watch_read(pending_read&& read,
+                    std::shared_ptr<hedge_outcome> outcome,
+                    std::chrono::steady_clock::time_point deadline);
+
+    // The server to send a read of `key` to, picked under one hold of
+    // `read_policy_lock_`.
+    read_route pick_read_server(const std::string& key,
+                                read_consistency consistency);
 
-    bool try_handle_leader_change(int32_t raft_result_code);
+    // If `result`, which came from `tried`, says the leader has changed,
+    // update the cached leader and return `true`. The server's leader hint
+    // is used when there is one, so no extra round trip is needed.
+    bool try_handle_leader_change(const rpc_mutation_result& result,
+                                  int32_t tried);
 
-    rpc_mutation_result retry_mutation(const std::string& key,
-                                       std::function<rpc_mutation_result()> f);
+    // Call `f` on a connection to the leader, following leader changes.
+    rpc_mutation_result retry_mutation(
+        const std::string& key,
+        const std::function<rpc_mutation_result(rpc::client&)>& f);
 };
 
 }  // namespace replicated_splinterdb
@@ -0,0 +1,93 @@
+#ifndef REPLICATED_SPLINTERDB_CLIENT_CONNECTION_POOL_H
+#define REPLICATED_SPLINTERDB_CLIENT_CONNECTION_POOL_H
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "rpc/client.h"
+
+namespace replicated_splinterdb {
+
+/**
+ * A fixed number of connections to one server.
+ *
+ * Connections are opened the first time they are needed and reopened once
+ * rpclib reports them as lost. Each request goes to the connection with the
+ * fewest requests outstanding, so one slow response only holds up the
+ * requests pipelined behind it on the same connection.
+ */
+class connection_pool {
+  public:
+    // A connection checked out of the pool. The request it is used for
+    // counts as outstanding until the lease is destroyed.
+    class lease {
+      public:
+        lease(const lease&) = delete;
+
+        lease& operator=(const lease&) = delete;
+
+        lease(lease&& other) noexcept
+            : conn_(std::move(other.conn_)), outstanding_(other.outstanding_) {
+            other.outstanding_ = nullptr;
+        }
+
+        lease& operator=(lease&& other) = delete;
+
+        ~lease() {
+            if (outstanding_ != nullptr) {
+                --*outstanding_;
+            }
+        }
+
+        rpc::client& operator*() const { return *conn_; }
+
+        rpc::client* operator->() const { return conn_.get(); }
+
+      private:
+        friend class connection_pool;
+
+        lease(std::shared_ptr<rpc::client> conn,
+              std::atomic<size_t>* outstanding)
+            : conn_(std::move(conn)), outstanding_(outstanding) {}
+
+        std::shared_ptr<rpc::client> conn_;
+        std::atomic<size_t>* outstanding_;
+    };
+
+    connection_pool(const std::string& host, uint16_t port, size_t size,
+                    int64_t timeout_ms);
+
+    connection_pool(const connection_pool&) = delete;
+
+    connection_pool& operator=(const connection_pool&) = delete;
+
+    // Check out the connection with the fewest outstanding requests.
+    lease acquire();
+
+    const std::string& host() const { return host_; }
+
+    uint16_t port() const { return port_; }
+
+  private:
+    struct slot {
+        // Null until the connection is first needed.
+        std::shared_ptr<rpc::client> conn_;
+        std::atomic<size_t> outstanding_{0};
+    };
+
+    std::string host_;
+    uint16_t port_;
+    int64_t timeout_ms_;
+
+    std::vector<slot> slots_;
+
+    // Mutex for opening and replacing the connections in `slots_`.
+    std::mutex lock_;
+};
+
+}  // namespace replicated_splinterdb
+
+#endif  // REPLICATED_SPLINTERDB_CLIENT_CONNECTION_POOL_H
@@ -0,0 +1,59 @@
+#ifndef REPLICATED_SPLINTERDB_CLIENT_LATENCY_HISTOGRAM_H
+#define REPLICATED_SPLINTERDB_CLIENT_LATENCY_HISTOGRAM_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace replicated_splinterdb {
+
+/**
+ * Histogram of recent latencies, for estimating percentiles.
+ *
+ * There are four buckets per power of two, so a percentile is accurate to
+ * within 25%. Counts are halved every `window` samples so the
+ * histogram follows the current latencies. Safe to use from several
+ * threads without locking.
+ */
+class latency_histogram {
+  public:
+    explicit latency_histogram(uint64_t window = 4096);
+
+    latency_histogram(const latency_histogram&) = delete;
+
+    latency_histogram& operator=(const latency_histogram&) = delete;
+
+    void record(std::chrono::nanoseconds latency);
+
+    /**
+     * Estimate a percentile of the recorded latencies.
+     *
+     * @param p Percentile, in (0, 1].
+     * @return The upper bound of the bucket holding the percentile, or zero
+     *         if nothing has been recorded.
+     */
+    std::chrono::microseconds percentile(double p) const;
+
+  private:
+    static constexpr size_t NUM_BUCKETS = 128;
+
+    // Bucket 0 holds latencies below 1 us. Every power of two above that is
+    // split into four buckets, and the last bucket takes everything beyond.
+    static size_t bucket_of(uint64_t latency_us);
+
+    static uint64_t bucket_upper_bound_us(size_t bucket);
+
+    void decay();
+
+    const uint64_t window_;
+
+    std::array<std::atomic<uint64_t>, NUM_BUCKETS> buckets_;
+
+    // Samples recorded so far, to schedule decays.
+    std::atomic<uint64_t> samples_;
+};
+
+}  // namespace replicated_splinterdb
+
+#endif  // REPLICATED_SPLINTERDB_CLIENT_LATENCY_HISTOGRAM_H
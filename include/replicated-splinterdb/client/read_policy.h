@@ -1,6 +1,9 @@
 #ifndef REPLICATED_SPLINTERDB_READ_POLICY_H
 #define REPLICATED_SPLINTERDB_READ_POLICY_H
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <memory>
 #include <numeric>
 #include <random>
@@ -12,7 +15,14 @@ namespace replicated_splinterdb {
 
 class read_policy {
   public:
-    enum class algorithm { hash, round_robin, random_token, random_uniform, fixed };
+    enum class algorithm {
+        hash,
+        round_robin,
+        random_token,
+        random_uniform,
+        fixed,
+        latency_aware
+    };
 
     explicit read_policy(const std::vector<int32_t>& server_ids)
         : server_ids_(server_ids) {}
@@ -21,10 +31,41 @@ class read_policy {
 
     int32_t next_server(const std::string& k) { return server_ids_[next(k)]; }
 
+    // Number of servers the policy routes to.
+    size_t num_servers() const { return server_ids_.size(); }
+
+    // The server to send a second copy of a read of `k` to, if `primary`
+    // is slow to answer. Returns `primary` if there is no other server.
+    int32_t alternate_server(const std::string& k, int32_t primary) {
+        auto it = std::find(server_ids_.begin(), server_ids_.end(), primary);
+        if (it == server_ids_.end()) {
+            return server_ids_[next(k)];
+        }
+        if (server_ids_.size() < 2) {
+            return primary;
+        }
+        return server_ids_[alternate(
+            k, static_cast<size_t>(it - server_ids_.begin()))];
+    }
+
+    // Called when a read is sent to `server_id`. Unlike `next_server()`,
+    // this may be called concurrently, without the client's policy lock.
+    virtual void on_request_start(int32_t server_id) {}
+
+    // Called when a read sent to `server_id` has completed, successfully or
+    // not. May be called concurrently, like `on_request_start()`.
+    virtual void on_request_end(int32_t server_id,
+                                std::chrono::nanoseconds latency) {}
+
   protected:
     virtual size_t next(const std::string& key) = 0;
 
-    size_t num_servers() { return server_ids_.size(); }
+    // Any server but `primary`; the one after it by default.
+    virtual size_t alternate(const std::string& key, size_t primary) {
+        return (primary + 1) % num_servers();
+    }
+
+    const std::vector<int32_t>& server_ids() const { return server_ids_; }
 
   private:
     std::vector<int32_t> server_ids_;
@@ -69,34 +110,32 @@ class range_based_read_policy : public read_policy {
   public:
     range_based_read_policy(const std::vector<int32_t>& server_ids,
                             size_t num_tokens)
-        : read_policy(server_ids), ranges_() {
+        : read_policy(server_ids), incr_(0), total_tokens_(0) {
         if (num_tokens == 0) {
             throw std::invalid_argument("num_tokens cannot be 0");
         }
-        size_t total_tokens = num_servers() * num_tokens;
-        T incr = std::numeric_limits<T>::max() / static_cast<T>(total_tokens);
-        T next = 0;
-
-        for (size_t i = 0; i < total_tokens; ++i) {
-            next += incr;
-            ranges_.push_back(next);
-        }
+        total_tokens_ = num_servers() * num_tokens;
+        incr_ = std::numeric_limits<T>::max() / static_cast<T>(total_tokens_);
     }
 
   protected:
-    std::vector<T> ranges_;
+    // Token range i is (i * incr_, (i + 1) * incr_], and the ranges are
+    // handed out to servers round robin. Range 0 also takes 0 and whatever
+    // is left above the last range once the token space is divided evenly.
+    T incr_;
+    size_t total_tokens_;
 
     virtual T get_token(const std::string& key) = 0;
 
     size_t next(const std::string& key) override {
         T token = get_token(key);
-        for (size_t i = 0; i < ranges_.size(); ++i) {
-            if (token <= ranges_[i]) {
-                return i % num_servers();
-            }
+        // The ranges are evenly spaced, so the range is computed directly
+        // rather than searched for.
+        auto range = static_cast<size_t>(token == 0 ? 0 : (token - 1) / incr_);
+        if (range >= total_tokens_) {
+            range = 0;
         }
-
-        return (size_t)-1;
+        return range % num_servers();
     }
 };
 
@@ -117,31 +156,107 @@ class random_token_read_policy : public range_based_read_policy<uint32_t> {
     std::uniform_int_distribution<uint32_t> distr_;
 };
 
-class hash_read_policy : public range_based_read_policy<uint32_t> {
+/**
+ * Consistent hashing: every server owns `num_tokens` virtual nodes on a
+ * hash ring, placed by hashing the server's ID, and a key belongs to the
+ * first virtual node at or after the key's hash.
+ *
+ * Virtual node positions only depend on their server's ID, so adding or
+ * removing a server only moves the keys next to its own virtual nodes,
+ * about 1/N of them, and every other replica keeps its cache warm.
+ */
+class hash_read_policy : public read_policy {
   public:
-    hash_read_policy(const std::vector<int32_t>& server_ids, size_t num_tokens)
-        : range_based_read_policy(server_ids, num_tokens) {}
+    hash_read_policy(const std::vector<int32_t>& server_ids, size_t num_tokens);
 
   protected:
-    uint32_t get_token(const std::string& key) override;
+    size_t next(const std::string& key) override;
+
+    // The owner of the next virtual node after the key's that `primary`
+    // does not own, so each key has a stable second replica.
+    size_t alternate(const std::string& key, size_t primary) override;
+
+  private:
+    // Ring positions of the virtual nodes, in ascending order.
+    std::vector<uint32_t> ring_;
+
+    // The index of the server owning each virtual node in `ring_`.
+    std::vector<size_t> owners_;
 };
 
-class fixed_read_policy : public read_policy {
+/**
+ * Routes each read to the key's hash-ring replica unless another replica is
+ * clearly faster right now.
+ *
+ * For every read, the key's home replica is compared with one other replica
+ * picked at random (power of two choices). Each is scored by the EWMA of
+ * its read latency times one plus its outstanding reads, and the other
+ * replica only wins if its score is lower by more than `slack`. That keeps
+ * cache affinity while replicas perform alike, and moves reads off one that
+ * is compacting or has a cold cache. Latencies decay towards zero while a
+ * replica goes unused, so a replica that was slow is tried again later.
+ */
+class latency_aware_read_policy : public hash_read_policy {
   public:
-    explicit fixed_read_policy(const std::vector<int32_t>& server_ids)
-        : read_policy(server_ids), mapping_() {}
+    latency_aware_read_policy(const std::vector<int32_t>& server_ids,
+                              size_t num_tokens, double slack = 0.5);
 
-    void set_mapping(std::unordered_map<std::string, size_t>&& m) {
-        mapping_ = std::forward<std::unordered_map<std::string, size_t>>(m);
-    }
+    void on_request_start(int32_t server_id) override;
+
+    void on_request_end(int32_t server_id,
+                        std::chrono::nanoseconds latency) override;
+
+  protected:
+    size_t next(const std::string& key) override;
+
+  private:
+    struct server_stats {
+        // EWMA of the read latency, in nanoseconds.
+        std::atomic<uint64_t> ewma_ns_{0};
+        // When `ewma_ns_` was last updated, in steady clock nanoseconds.
+        std::atomic<int64_t> updated_ns_{0};
+        std::atomic<uint32_t> outstanding_{0};
+    };
+
+    double score(size_t idx, int64_t now_ns) const;
+
+    server_stats* stats_for(int32_t server_id);
+
+    double slack_;
+    std::unique_ptr<server_stats[]> stats_;
+    std::unordered_map<int32_t, size_t> indexes_;
+    std::mt19937 rng_;
+};
+
+/**
+ * Routes the keys in an explicit mapping to the replica they are mapped to,
+ * and every other key like `hash_read_policy`. The mapping can be set by
+ * hand, or rebalanced by the client from the replicas' hot-key statistics.
+ */
+class fixed_read_policy : public hash_read_policy {
+  public:
+    using mapping = std::unordered_map<std::string, size_t>;
+
+    fixed_read_policy(const std::vector<int32_t>& server_ids,
+                      size_t num_tokens)
+        : hash_read_policy(server_ids, num_tokens), mapping_() {}
+
+    // Map keys to indexes into the server IDs the policy was built with.
+    void set_mapping(mapping&& m) { mapping_ = std::forward<mapping>(m); }
+
+    const mapping& get_mapping() const { return mapping_; }
 
   protected:
     size_t next(const std::string& key) override {
-        return mapping_.at(key);
+        auto it = mapping_.find(key);
+        if (it != mapping_.end() && it->second < num_servers()) {
+            return it->second;
+        }
+        return hash_read_policy::next(key);
     }
 
   private:
-    std::unordered_map<std::string, size_t> mapping_;
+    mapping mapping_;
 };
 
 }  // namespace replicated_splinterdb
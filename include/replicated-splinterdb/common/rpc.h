@@ -1,19 +1,34 @@
 #ifndef REPLICATED_SPLINTERDB_COMMON_RPC_H
 #define REPLICATED_SPLINTERDB_COMMON_RPC_H
 
+// Version of the client-server protocol: the RPC arguments and the
+// msgpack layout of the types in types.h. Bump it on any incompatible
+// change. Clients refuse to talk to a server with a different version, so
+// clients and servers must be upgraded together.
+//   1: the original protocol; servers that predate the version RPC.
+//   2: `rpc_mutation_result` carries the leader ID; gets take a
+//      `read_consistency`.
+#define RPC_PROTOCOL_VERSION 2
+
 // Join server RPCs
 #define RPC_JOIN_REPLICA_GROUP "join_replica_group"
 
 // Client-handling server RPCs
 #define RPC_PING "ping"
+#define RPC_GET_PROTOCOL_VERSION "get_protocol_version"
 #define RPC_GET_SRV_ID "get_srv_id"
 #define RPC_GET_LEADER_ID "get_leader_id"
 #define RPC_GET_ALL_SERVERS "get_all_servers"
 #define RPC_GET_SRV_ENDPOINT "get_srv_endpoint"
+#define RPC_GET_READ_INDEX "get_read_index"
 #define RPC_SPLINTERDB_GET "splinterdb_get"
+#define RPC_SPLINTERDB_MULTI_GET "splinterdb_multi_get"
+#define RPC_SPLINTERDB_SCAN "splinterdb_scan"
+#define RPC_SPLINTERDB_HOT_KEYS "splinterdb_hot_keys"
 #define RPC_SPLINTERDB_PUT "splinterdb_put"
 #define RPC_SPLINTERDB_UPDATE "splinterdb_update"
 #define RPC_SPLINTERDB_DELETE "splinterdb_delete"
+#define RPC_SPLINTERDB_WRITE_BATCH "splinterdb_write_batch"
 #define RPC_SPLINTERDB_DUMPCACHE "splinterdb_dumpcache"
 #define RPC_SPLINTERDB_CLEARCACHE "splinterdb_clearcache"
 
@@ -11,6 +11,23 @@
 
 namespace replicated_splinterdb {
 
+// How up to date a read has to be.
+enum class read_consistency : uint8_t {
+    // Read whatever the chosen replica has applied.
+    local,
+    // Read on the leader while a quorum has acknowledged it recently enough
+    // that no other replica can have been elected, without a round trip.
+    lease,
+    // Read on any replica once it has applied the leader's commit index.
+    read_index
+};
+
+// Return codes of reads that could not be served at the requested
+// consistency. SplinterDB return codes are never negative.
+inline constexpr int32_t READ_RC_NOT_LEADER = -1;
+inline constexpr int32_t READ_RC_NO_LEADER = -2;
+inline constexpr int32_t READ_RC_TIMED_OUT = -3;
+
 class rpc_read_result {
   public:
     rpc_read_result() = default;
@@ -39,6 +56,118 @@ class rpc_read_result {
     int32_t rc_;
 };
 
+class rpc_multi_read_result {
+  public:
+    rpc_multi_read_result() = default;
+
+    rpc_multi_read_result(const rpc_multi_read_result&) = delete;
+
+    rpc_multi_read_result& operator=(const rpc_multi_read_result&) = delete;
+
+    rpc_multi_read_result(rpc_multi_read_result&&) = default;
+
+    rpc_multi_read_result& operator=(rpc_multi_read_result&&) = default;
+
+    explicit rpc_multi_read_result(size_t size)
+        : values_(size), rcs_(size, 0) {}
+
+    MSGPACK_DEFINE_ARRAY(values_, rcs_);
+
+    size_t size() const { return rcs_.size(); }
+
+    // The value of the i-th key. Empty unless `rc(i)` is 0.
+    const std::string& value(size_t i) const { return values_[i]; }
+
+    std::string& value(size_t i) { return values_[i]; }
+
+    int32_t rc(size_t i) const { return rcs_[i]; }
+
+    void set_rc(size_t i, int32_t rc) { rcs_[i] = rc; }
+
+  private:
+    std::vector<std::string> values_;
+    std::vector<int32_t> rcs_;
+};
+
+class rpc_scan_result {
+  public:
+    rpc_scan_result() = default;
+
+    rpc_scan_result(const rpc_scan_result&) = delete;
+
+    rpc_scan_result& operator=(const rpc_scan_result&) = delete;
+
+    rpc_scan_result(rpc_scan_result&&) = default;
+
+    rpc_scan_result& operator=(rpc_scan_result&&) = default;
+
+    explicit rpc_scan_result(int32_t rc)
+        : keys_(), values_(), rc_(rc), resume_key_(), has_more_(false) {}
+
+    MSGPACK_DEFINE_ARRAY(keys_, values_, rc_, resume_key_, has_more_);
+
+    void add(std::string&& key, std::string&& value) {
+        keys_.push_back(std::forward<std::string>(key));
+        values_.push_back(std::forward<std::string>(value));
+    }
+
+    // Mark the page as cut short. The next page starts at `resume_key`.
+    void set_resume_key(std::string&& resume_key) {
+        resume_key_ = std::forward<std::string>(resume_key);
+        has_more_ = true;
+    }
+
+    size_t size() const { return keys_.size(); }
+
+    const std::vector<std::string>& keys() const { return keys_; }
+
+    const std::vector<std::string>& values() const { return values_; }
+
+    int32_t rc() const { return rc_; }
+
+    bool has_more() const { return has_more_; }
+
+    const std::string& resume_key() const { return resume_key_; }
+
+  private:
+    std::vector<std::string> keys_;
+    std::vector<std::string> values_;
+    int32_t rc_;
+    std::string resume_key_;
+    bool has_more_;
+};
+
+class rpc_hot_keys {
+  public:
+    rpc_hot_keys() = default;
+
+    rpc_hot_keys(const rpc_hot_keys&) = delete;
+
+    rpc_hot_keys& operator=(const rpc_hot_keys&) = delete;
+
+    rpc_hot_keys(rpc_hot_keys&&) = default;
+
+    rpc_hot_keys& operator=(rpc_hot_keys&&) = default;
+
+    MSGPACK_DEFINE_ARRAY(keys_, counts_);
+
+    void add(std::string&& key, uint64_t count) {
+        keys_.push_back(std::forward<std::string>(key));
+        counts_.push_back(count);
+    }
+
+    size_t size() const { return keys_.size(); }
+
+    const std::string& key(size_t i) const { return keys_[i]; }
+
+    // Approximate number of recent lookups of the i-th key.
+    uint64_t count(size_t i) const { return counts_[i]; }
+
+  private:
+    std::vector<std::string> keys_;
+    std::vector<uint64_t> counts_;
+};
+
 class rpc_mutation_result {
   public:
     rpc_mutation_result() = default;
@@ -52,12 +181,15 @@ class rpc_mutation_result {
     rpc_mutation_result& operator=(rpc_mutation_result&&) = default;
 
     rpc_mutation_result(int32_t splinterdb_rc, int32_t raft_rc,
-                        const std::string& raft_msg)
+                        const std::string& raft_msg, int32_t leader_id = -1)
         : splinterdb_rc_(splinterdb_rc),
           raft_rc_(raft_rc),
-          raft_msg_(raft_msg) {}
+          raft_msg_(raft_msg),
+          leader_id_(leader_id) {}
 
-    MSGPACK_DEFINE_ARRAY(splinterdb_rc_, raft_rc_, raft_msg_);
+    // `leader_id_` was added in protocol version 2 (see rpc.h). Older peers
+    // fail to unpack the longer array.
+    MSGPACK_DEFINE_ARRAY(splinterdb_rc_, raft_rc_, raft_msg_, leader_id_);
 
     bool was_accepted() const { return raft_rc_ == 0; }
 
@@ -69,10 +201,54 @@ class rpc_mutation_result {
 
     const std::string& raft_msg() const { return raft_msg_; }
 
+    // The leader as seen by the server that answered, or -1 if it knew of
+    // none. Lets a client that reached a follower redirect right away.
+    int32_t leader_id() const { return leader_id_; }
+
+    void set_leader_id(int32_t leader_id) { leader_id_ = leader_id; }
+
   private:
     int32_t splinterdb_rc_;
     int32_t raft_rc_;
     std::string raft_msg_;
+    int32_t leader_id_;
+};
+
+class rpc_write_batch {
+  public:
+    enum op_type : uint8_t { PUT, UPDATE, DELETE };
+
+    // (type, key, value); the value is empty for deletes.
+    using op = std::tuple<uint8_t, std::string, std::string>;
+
+    rpc_write_batch() = default;
+
+    void put(const std::string& key, const std::string& value) {
+        ops_.emplace_back(PUT, key, value);
+    }
+
+    void update(const std::string& key, const std::string& value) {
+        ops_.emplace_back(UPDATE, key, value);
+    }
+
+    void del(const std::string& key) {
+        ops_.emplace_back(DELETE, key, std::string());
+    }
+
+    void clear() { ops_.clear(); }
+
+    MSGPACK_DEFINE_ARRAY(ops_);
+
+    size_t size() const { return ops_.size(); }
+
+    bool empty() const { return ops_.empty(); }
+
+    const std::vector<op>& ops() const { return ops_; }
+
+    std::vector<op>& ops() { return ops_; }
+
+  private:
+    std::vector<op> ops_;
 };
 
 class rpc_server_info {
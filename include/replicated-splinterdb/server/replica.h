@@ -1,6 +1,7 @@
 #ifndef REPLICATED_SPLINTERDB_SERVER_REPLICA_H
 #define REPLICATED_SPLINTERDB_SERVER_REPLICA_H
 
+#include <chrono>
 #include <memory>
 
 #include "libnuraft/nuraft.hxx"
@@ -35,6 +36,23 @@ class replica {
 
     std::pair<std::unique_ptr<std::string>, int32_t> read(slice&& key);
 
+    // Read `key` into `value`, reusing its storage. Returns the SplinterDB
+    // return code.
+    int32_t read(slice key, std::string& value);
+
+    /**
+     * Visit keys in order, starting at `start_key`, until `visit` returns
+     * `false` or there are no keys left.
+     *
+     * @param start_key First key to visit, or an empty slice to start at the
+     *                  smallest key.
+     * @param visit Called with each key and value. The slices are only
+     *              valid during the call.
+     * @return SplinterDB return code.
+     */
+    int32_t scan(slice start_key,
+                 const std::function<bool(slice key, slice value)>& visit);
+
     std::pair<nuraft::cmd_result_code, std::string> add_server(
         int32_t server_id, const std::string& raft_endpoint,
         const std::string& client_endpoint);
@@ -48,8 +66,45 @@ class replica {
 
     int32_t get_id() const { return server_id_; }
 
+    // Whether this replica picked up the Raft state and SplinterDB file of
+    // an earlier run, and so is already a member of its group.
+    bool is_recovered() const { return recovered_; }
+
     int32_t get_leader() const { return raft_instance_->get_leader(); }
 
+    // Whether this replica is the leader, has committed a log of its
+    // current term, and a quorum acknowledged it within the lease. Until it
+    // has committed in its term, its commit index can be behind logs that
+    // an earlier leader committed.
+    bool has_leader_lease() const;
+
+    /**
+     * Confirm that this replica is still the leader by waiting for a quorum
+     * to acknowledge a heartbeat sent after the call. Concurrent callers
+     * share the same heartbeats, and nothing is added to the log.
+     *
+     * @param timeout_ms Maximum time to wait.
+     * @return `true` if a quorum acknowledged this replica within
+     *         `timeout_ms`.
+     */
+    bool confirm_leadership(uint64_t timeout_ms);
+
+    // How long Raft lets a client request wait for its log to commit.
+    uint64_t get_client_timeout_ms() const { return client_timeout_ms_; }
+
+    uint64_t get_committed_index() const {
+        return raft_instance_->get_committed_log_idx();
+    }
+
+    /**
+     * Wait until the local state machine has applied the given log.
+     *
+     * @param log_idx Raft log number to wait for.
+     * @param timeout_ms Maximum time to wait.
+     * @return `true` if the log was applied within `timeout_ms`.
+     */
+    bool wait_for_commit(uint64_t log_idx, uint64_t timeout_ms);
+
     nuraft::ptr<nuraft::srv_config> get_server_info(int32_t server_id) const {
         return raft_instance_->get_srv_config(server_id);
     }
@@ -80,9 +135,23 @@ class replica {
     nuraft::ptr<nuraft::logger> logger_;
     FILE* spl_log_file_;
     nuraft::ptr<splinterdb_state_machine> sm_;
+    nuraft::ptr<nuraft::log_store> log_store_;
     nuraft::ptr<nuraft::state_mgr> smgr_;
     nuraft::raft_launcher launcher_;
     nuraft::ptr<nuraft::raft_server> raft_instance_;
+    bool recovered_;
+    uint64_t client_timeout_ms_;
+
+    // How long after a quorum last acknowledged it the leader may serve
+    // lease reads.
+    std::chrono::milliseconds lease_duration_;
+
+    // How often `confirm_leadership` looks for acknowledgements.
+    std::chrono::milliseconds confirm_poll_interval_;
+
+    // When the most recent acknowledgement from a quorum, counting this
+    // replica, arrived. Only meaningful on the leader.
+    std::chrono::steady_clock::time_point quorum_ack_time() const;
 
     static void default_raft_params_init(nuraft::raft_params& params);
 
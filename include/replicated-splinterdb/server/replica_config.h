@@ -11,6 +11,20 @@
 
 namespace replicated_splinterdb {
 
+enum class log_store_type { in_memory, segmented };
+
+enum class log_fsync_policy {
+    // Never fsync; the OS decides when appended entries reach the disk.
+    never,
+    // fsync the active segment whenever Raft asks the log store to flush.
+    on_flush,
+    // fsync the active segment after every appended entry.
+    always,
+    // Appends return immediately and a background thread fsyncs whatever
+    // has been appended since its last pass, then notifies Raft.
+    group_commit
+};
+
 struct replica_config {
     replica_config(const data_config& splinterdb_data_cfg,
                    const splinterdb_config& splinterdb_cfg)
@@ -19,9 +33,19 @@ struct replica_config {
           client_port_(25001),
           addr_("localhost"),
           asio_thread_pool_size_(0),
+          lookup_threads_(4),
+          hot_key_capacity_(256),
           snapshot_frequency_(0),
+          reserved_log_items_(100000),
+          snapshot_obj_size_(1024 * 1024),
+          log_compression_threshold_(1024),
           initialization_delay_ms_(250),
           initialization_retries_(20),
+          log_store_type_(log_store_type::segmented),
+          log_store_dir_(std::nullopt),
+          log_segment_size_(64 * 1024 * 1024),
+          log_fsync_policy_(log_fsync_policy::group_commit),
+          state_dir_(std::nullopt),
           raft_log_file_(std::nullopt),
           log_level_(LogLevel::INFO),
           display_level_(LogLevel::WARNING),
@@ -38,6 +62,10 @@ struct replica_config {
         return return_method_;
     }
 
+    void set_return_method(nuraft::raft_params::return_method_type method) {
+        return_method_ = method;
+    }
+
     // Replica identifier parameters
 
     int32_t server_id_;
@@ -49,12 +77,36 @@ struct replica_config {
 
     size_t asio_thread_pool_size_;
 
+    // Client RPC parameters
+
+    // Threads that multi-key reads fan their lookups out to.
+    size_t lookup_threads_;
+    // Number of most looked-up keys to track for clients; 0 disables.
+    size_t hot_key_capacity_;
+
     // Raft-specific parameters
 
     int32_t snapshot_frequency_;
+    int32_t reserved_log_items_;
+    size_t snapshot_obj_size_;
+    // Values at least this large are compressed in log entries; 0 disables.
+    size_t log_compression_threshold_;
     size_t initialization_delay_ms_;
     size_t initialization_retries_;
 
+    // Raft log store parameters
+
+    log_store_type log_store_type_;
+    std::optional<std::string> log_store_dir_;
+    size_t log_segment_size_;
+    log_fsync_policy log_fsync_policy_;
+
+    // Raft state parameters
+
+    // Where the term, vote and cluster configuration are kept. Only used
+    // with an on-disk log store; otherwise nothing survives a restart.
+    std::optional<std::string> state_dir_;
+
     // Logging information
 
     std::optional<std::string> raft_log_file_;
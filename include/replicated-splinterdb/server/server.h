@@ -1,13 +1,21 @@
 #ifndef REPLICATED_SPLINTERDB_SERVER_SERVER_H
 #define REPLICATED_SPLINTERDB_SERVER_SERVER_H
 
+#include <memory>
+#include <mutex>
+
+#include "replicated-splinterdb/common/types.h"
 #include "replicated-splinterdb/server/replica.h"
 #include "replicated-splinterdb/server/replica_config.h"
+#include "rpc/client.h"
 #include "rpc/server.h"
 #include "rpc/this_handler.h"
 
 namespace replicated_splinterdb {
 
+class hot_key_sketch;
+class lookup_pool;
+
 class server {
   public:
     server() = delete;
@@ -22,6 +30,9 @@ class server {
 
     void run(uint64_t nthreads);
 
+    // Whether the replica recovered its state from an earlier run.
+    bool is_recovered() const { return replica_instance_.is_recovered(); }
+
   private:
     replica replica_instance_;
 
@@ -29,7 +40,40 @@ class server {
 
     rpc::server join_srv_;
 
+    // Threads that multi-key reads fan their lookups out to.
+    std::unique_ptr<lookup_pool> lookup_pool_;
+
+    // Lookup counts of the hottest keys, or null if not tracked.
+    std::unique_ptr<hot_key_sketch> hot_keys_;
+
+    // Connection to the leader's client port, for `read_index` reads.
+    std::shared_ptr<rpc::client> leader_client_;
+
+    // Server ID that `leader_client_` is connected to.
+    int32_t leader_client_id_;
+
+    // Mutex for `leader_client_` and `leader_client_id_`.
+    std::mutex leader_client_lock_;
+
     void initialize();
+
+    // Wait until a local read observes every write committed before the
+    // call, as far as `consistency` requires. Returns 0 or a READ_RC_* code.
+    int32_t sync_for_read(read_consistency consistency);
+
+    // The read index this replica serves as leader: its commit index, once
+    // a round with a quorum has confirmed it is still the leader. Returns
+    // READ_RC_NOT_LEADER if it is not.
+    int64_t leader_read_index();
+
+    // Ask the leader for its commit index. Returns a READ_RC_* code if
+    // there is no leader that can answer.
+    int64_t fetch_read_index();
+
+    std::shared_ptr<rpc::client> get_leader_client(int32_t leader_id);
+
+    // Replicate `op` and return its outcome once it is committed.
+    rpc_mutation_result replicate(const splinterdb_operation& op);
 };
 
 }  // namespace replicated_splinterdb
@@ -1,17 +1,37 @@
 #ifndef REPLICATED_SPLINTERDB_SERVER_SPLINTERDB_OPERATION_H
 #define REPLICATED_SPLINTERDB_SERVER_SPLINTERDB_OPERATION_H
 
+#include <memory>
 #include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
 
 #include "libnuraft/buffer_serializer.hxx"
 
 namespace replicated_splinterdb {
 
+// Keys starting with this prefix hold the replica's own metadata. Clients
+// can neither see nor write them.
+inline constexpr std::string_view RESERVED_KEY_PREFIX{"\0rsdb:", 6};
+
+inline bool is_reserved_key(std::string_view key) {
+    return key.substr(0, RESERVED_KEY_PREFIX.size()) == RESERVED_KEY_PREFIX;
+}
+
 class splinterdb_operation {
   public:
-    enum splinterdb_operation_type : uint8_t { PUT, UPDATE, DELETE };
-
-    nuraft::ptr<nuraft::buffer> serialize() const;
+    enum splinterdb_operation_type : uint8_t { PUT, UPDATE, DELETE, BATCH };
+
+    /**
+     * Encode the operation as a Raft log payload.
+     *
+     * @param compress_threshold Values of at least this many bytes are
+     *                           compressed if that makes them smaller.
+     *                           0 disables compression.
+     * @return Log payload.
+     */
+    nuraft::ptr<nuraft::buffer> serialize(size_t compress_threshold = 0) const;
 
     const std::string& key() const { return key_; }
 
@@ -19,16 +39,26 @@ class splinterdb_operation {
 
     splinterdb_operation_type type() const { return type_; }
 
+    // The sub-operations of a BATCH operation, in the order they apply.
+    const std::vector<splinterdb_operation>& batch() const { return batch_; }
+
     static splinterdb_operation deserialize(nuraft::buffer& payload_in);
 
     static splinterdb_operation make_put(std::string&& key,
                                          std::string&& value);
 
+    // A SplinterDB merge update. It cannot be serialized: replaying it is
+    // not idempotent, which snapshots rely on. Clients' updates are logged
+    // as puts.
     static splinterdb_operation make_update(std::string&& key,
                                             std::string&& value);
 
     static splinterdb_operation make_delete(std::string&& key);
 
+    // Make a single log entry out of several PUT/DELETE operations.
+    static splinterdb_operation make_batch(
+        std::vector<splinterdb_operation>&& ops);
+
   private:
     splinterdb_operation(std::string&& key, std::optional<std::string>&& value,
                          splinterdb_operation_type type);
@@ -38,6 +68,51 @@ class splinterdb_operation {
     std::string key_;
     std::optional<std::string> value_;
     splinterdb_operation_type type_;
+    std::vector<splinterdb_operation> batch_;
+};
+
+/**
+ * Non-owning decode of a serialized `splinterdb_operation`.
+ *
+ * Keys and values point directly into the buffer the view was decoded from,
+ * so the view must not outlive it. Used on the commit path, where the log
+ * entry stays alive for the duration of `state_machine::commit()`.
+ */
+class splinterdb_operation_view {
+  public:
+    using operation_type = splinterdb_operation::splinterdb_operation_type;
+
+    std::string_view key() const { return key_; }
+
+    std::string_view value() const { return value_; }
+
+    operation_type type() const { return type_; }
+
+    // The sub-operations of a BATCH operation, in the order they apply.
+    const std::vector<splinterdb_operation_view>& batch() const {
+        return batch_;
+    }
+
+    static splinterdb_operation_view decode(nuraft::buffer& payload_in);
+
+  private:
+    splinterdb_operation_view() = default;
+
+    static splinterdb_operation_view decode_legacy(
+        nuraft::buffer_serializer& bs);
+
+    // `in_batch` is set for the operations of a batch, which cannot be
+    // batches themselves.
+    static splinterdb_operation_view decode_v1(nuraft::buffer_serializer& bs,
+                                               bool in_batch);
+
+    std::string_view key_;
+    std::string_view value_;
+    operation_type type_;
+    std::vector<splinterdb_operation_view> batch_;
+
+    // Holds the value if it had to be decompressed.
+    std::unique_ptr<std::string> inflated_;
 };
 
 }  // namespace replicated_splinterdb
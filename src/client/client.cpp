@@ -1,12 +1,15 @@
 #include "replicated-splinterdb/client/client.h"
 
+#include <algorithm>
 #include <chrono>
+#include <future>
 #include <iostream>
+#include <limits>
+#include <optional>
 #include <thread>
 
 #include "replicated-splinterdb/common/rpc.h"
-
-// TODOS: Implement latency-based read policy
+#include "rpc/rpc_error.h"
 
 #define GET_LEADER_NO_LIVE_LEADER (-1)
 #define CMD_RESULT_NOT_LEADER (-3)
@@ -17,14 +20,107 @@ namespace replicated_splinterdb {
 
 using std::string;
 
+// Reports the latency of a read to the read policy, when stopped or
+// destroyed.
+class read_timer {
+  public:
+    read_timer(std::shared_ptr<read_policy> policy, int32_t server_id)
+        : policy_(std::move(policy)),
+          server_id_(server_id),
+          start_(std::chrono::steady_clock::now()) {
+        if (policy_ != nullptr) {
+            policy_->on_request_start(server_id_);
+        }
+    }
+
+    read_timer(const read_timer&) = delete;
+
+    read_timer& operator=(const read_timer&) = delete;
+
+    read_timer(read_timer&& other) noexcept
+        : policy_(std::move(other.policy_)),
+          server_id_(other.server_id_),
+          start_(other.start_) {}
+
+    read_timer& operator=(read_timer&&) = delete;
+
+    ~read_timer() { stop(); }
+
+    void stop() {
+        if (policy_ != nullptr) {
+            policy_->on_request_end(
+                server_id_, std::chrono::steady_clock::now() - start_);
+            policy_ = nullptr;
+        }
+    }
+
+  private:
+    std::shared_ptr<read_policy> policy_;
+    int32_t server_id_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+struct client::pending_read {
+    int32_t server_;
+    connection_pool::lease conn_;
+    read_timer timer_;
+    std::future<RPCLIB_MSGPACK::object_handle> response_;
+};
+
+struct client::hedge_outcome {
+    std::mutex lock_;
+    // Signalled when a read is answered, fails or times out.
+    std::condition_variable cv_;
+    // The first successful answer.
+    std::optional<rpc_read_result> result_;
+    // The last error, rethrown if every read failed.
+    std::exception_ptr error_;
+    size_t failed_ = 0;
+};
+
+// Throw if the server at the other end of `cl` speaks a different protocol.
+static void check_protocol_version(rpc::client& cl) {
+    uint32_t version;
+    try {
+        version = cl.call(RPC_GET_PROTOCOL_VERSION).as<uint32_t>();
+    } catch (const rpc::rpc_error&) {
+        // Servers before version 2 do not have the RPC.
+        version = 1;
+    }
+    if (version != RPC_PROTOCOL_VERSION) {
+        throw std::runtime_error(
+            "server speaks protocol version " + std::to_string(version) +
+            " but this client speaks " +
+            std::to_string(RPC_PROTOCOL_VERSION) +
+            "; upgrade clients and servers together");
+    }
+}
+
 client::client(const string& host, uint16_t port,
                read_policy::algorithm read_algo, size_t rp_num_tokens,
-               uint64_t timeout_ms, uint16_t num_retries, bool print_errors)
+               uint64_t timeout_ms, uint16_t num_retries, bool print_errors,
+               size_t connections_per_server)
     : clients_(),
+      clients_lock_(),
       read_policy_(nullptr),
+      read_policy_lock_(),
+      member_ids_(),
       algo_(read_algo),
+      rp_num_tokens_(rp_num_tokens),
+      timeout_ms_(timeout_ms),
+      connections_per_server_(connections_per_server),
+      leader_id_(GET_LEADER_NO_LIVE_LEADER),
       num_retries_(num_retries),
-      print_errors_(print_errors) {
+      print_errors_(print_errors),
+      read_latencies_(),
+      hedge_percentile_(0),
+      hedge_min_delay_us_(0),
+      read_watchers_(),
+      read_watchers_lock_(),
+      rebalancer_(),
+      rebalancer_lock_(),
+      rebalancer_cv_(),
+      stop_rebalancer_(false) {
     rpc::client cl{host, port};
 
     rpc_cluster_endpoints srvs;
@@ -33,6 +129,8 @@ client::client(const string& host, uint16_t port,
             throw std::runtime_error("server returned unexpected response");
         }
 
+        check_protocol_version(cl);
+
         srvs = cl.call(RPC_GET_ALL_SERVERS)
                    .as<rpc_cluster_endpoints>();
 
@@ -42,62 +140,119 @@ client::client(const string& host, uint16_t port,
         exit(1);
     }
 
-    for (const auto& srv : srvs.endpoints()) {
-        auto delim_idx = srv.endpoint().find(':');
-        string srv_host = srv.endpoint().substr(0, delim_idx);
-        int srv_port = std::stoi(srv.endpoint().substr(delim_idx + 1));
-
-        if (1 > srv_port || srv_port > 65535) {
-            string msg = "invalid port number for host \"" + srv_host +
-                         "\": " + std::to_string(srv_port);
-            throw std::runtime_error(msg);
-        }
-
-        auto checked_port = static_cast<uint16_t>(srv_port);
-        try {
-            clients_.emplace(std::piecewise_construct,
-                             std::forward_as_tuple(srv.id()),
-                             std::forward_as_tuple(srv_host, checked_port));
-        } catch (const std::exception& e) {
-            std::cerr << "WARNING: failed to connect to " << srv.endpoint()
-                      << " ... skipping. Reason:\n\t" << e.what() << std::endl;
-            continue;
-        }
-    }
-
-    std::vector<int32_t> srv_ids;
-    for (auto& [srv_id, c] : clients_) {
-        c.set_timeout(static_cast<int64_t>(timeout_ms));
-        srv_ids.push_back(srv_id);
-    }
+    update_membership(srvs);
+}
 
-    switch (read_algo) {
+static std::shared_ptr<read_policy> make_read_policy(
+    read_policy::algorithm algo, const std::vector<int32_t>& srv_ids,
+    size_t rp_num_tokens) {
+    switch (algo) {
         case read_policy::algorithm::round_robin:
-            read_policy_ = std::make_unique<round_robin_read_policy>(srv_ids);
-            break;
+            return std::make_shared<round_robin_read_policy>(srv_ids);
         case read_policy::algorithm::hash:
-            read_policy_ =
-                std::make_unique<hash_read_policy>(srv_ids, rp_num_tokens);
-            break;
+            return std::make_shared<hash_read_policy>(srv_ids, rp_num_tokens);
         case read_policy::algorithm::random_token:
-            read_policy_ = std::make_unique<random_token_read_policy>(
-                srv_ids, rp_num_tokens);
-            break;
+            return std::make_shared<random_token_read_policy>(srv_ids,
+                                                              rp_num_tokens);
         case read_policy::algorithm::random_uniform:
-            read_policy_ =
-                std::make_unique<random_uniform_read_policy>(srv_ids);
-            break;
+            return std::make_shared<random_uniform_read_policy>(srv_ids);
         case read_policy::algorithm::fixed:
-            read_policy_ = std::make_unique<fixed_read_policy>(srv_ids);
-            break;
+            return std::make_shared<fixed_read_policy>(srv_ids,
+                                                       rp_num_tokens);
+        case read_policy::algorithm::latency_aware:
+            return std::make_shared<latency_aware_read_policy>(srv_ids,
+                                                               rp_num_tokens);
         default:
             throw std::runtime_error("Invalid read policy");
     }
 }
 
+client::~client() {
+    {
+        std::lock_guard<std::mutex> guard(rebalancer_lock_);
+        stop_rebalancer_ = true;
+    }
+    rebalancer_cv_.notify_all();
+
+    if (rebalancer_.joinable()) {
+        rebalancer_.join();
+    }
+
+    // Each watcher gives up at its read's deadline, so this blocks for at
+    // most `timeout_ms_`.
+    std::lock_guard<std::mutex> guard(read_watchers_lock_);
+    read_watchers_.clear();
+}
+
+bool client::update_membership(const rpc_cluster_endpoints& srvs) {
+    std::vector<int32_t> srv_ids;
+    {
+        std::unique_lock<std::shared_mutex> guard(clients_lock_);
+        for (const auto& srv : srvs.endpoints()) {
+            srv_ids.push_back(srv.id());
+            if (clients_.count(srv.id()) > 0) {
+                continue;
+            }
+
+            auto delim_idx = srv.endpoint().find(':');
+            string srv_host = srv.endpoint().substr(0, delim_idx);
+            int srv_port = std::stoi(srv.endpoint().substr(delim_idx + 1));
+
+            if (1 > srv_port || srv_port > 65535) {
+                string msg = "invalid port number for host \"" + srv_host +
+                             "\": " + std::to_string(srv_port);
+                throw std::runtime_error(msg);
+            }
+
+            // Pools are never removed, since requests in flight may still
+            // hold connections from them. A removed server is simply no
+            // longer picked by the read policy.
+            auto checked_port = static_cast<uint16_t>(srv_port);
+            clients_.emplace(srv.id(), std::make_unique<connection_pool>(
+                                           srv_host, checked_port,
+                                           connections_per_server_,
+                                           static_cast<int64_t>(timeout_ms_)));
+        }
+    }
+    std::sort(srv_ids.begin(), srv_ids.end());
+
+    std::lock_guard<std::mutex> guard(read_policy_lock_);
+    if (srv_ids == member_ids_) {
+        return false;
+    }
+
+    // A fixed mapping was set against the original servers, so it is kept
+    // as is rather than silently dropped.
+    if (read_policy_ == nullptr || algo_ != read_policy::algorithm::fixed) {
+        read_policy_ = make_read_policy(algo_, srv_ids, rp_num_tokens_);
+    }
+    member_ids_ = std::move(srv_ids);
+    return true;
+}
+
+bool client::refresh_membership() {
+    return update_membership(get_all_servers());
+}
+
+std::vector<std::pair<int32_t, connection_pool*>> client::all_pools() {
+    std::shared_lock<std::shared_mutex> guard(clients_lock_);
+    std::vector<std::pair<int32_t, connection_pool*>> pools;
+    for (auto& [id, pool] : clients_) {
+        pools.emplace_back(id, pool.get());
+    }
+    return pools;
+}
+
+std::shared_ptr<read_policy> client::current_read_policy() {
+    std::lock_guard<std::mutex> guard(read_policy_lock_);
+    return read_policy_;
+}
+
 void client::trigger_cache_dumps(const string& directory) {
-    for (auto& [id, c] : clients_) {
-        bool result = c.call(RPC_SPLINTERDB_DUMPCACHE, directory).as<bool>();
+    for (auto& [id, pool] : all_pools()) {
+        bool result = pool->acquire()
+                          ->call(RPC_SPLINTERDB_DUMPCACHE, directory)
+                          .as<bool>();
 
         if (!result) {
             std::cerr << "WARNING: failed to dump cache on server " << id
@@ -107,8 +262,9 @@ void client::trigger_cache_dumps(const string& directory) {
 }
 
 void client::trigger_cache_clear() {
-    for (auto& [id, c] : clients_) {
-        bool result = c.call(RPC_SPLINTERDB_CLEARCACHE).as<bool>();
+    for (auto& [id, pool] : all_pools()) {
+        bool result =
+            pool->acquire()->call(RPC_SPLINTERDB_CLEARCACHE).as<bool>();
 
         if (!result) {
             std::cerr << "WARNING: failed to clear cache on server " << id
@@ -117,44 +273,309 @@ void client::trigger_cache_clear() {
     }
 }
 
-rpc::client& client::get_leader_handle() { return clients_.at(leader_id_); }
+connection_pool::lease client::connection(int32_t server_id) {
+    connection_pool* pool;
+    {
+        std::shared_lock<std::shared_mutex> guard(clients_lock_);
+        pool = clients_.at(server_id).get();
+    }
+    return pool->acquire();
+}
 
-bool client::try_handle_leader_change(int32_t raft_result_code) {
-    if (raft_result_code == CMD_RESULT_NOT_LEADER ||
-        raft_result_code == CMD_RESULT_REQUEST_CANCELLED) {
-        int32_t old_leader_id = leader_id_;
+client::read_route client::pick_read_server(const string& key,
+                                            read_consistency consistency) {
+    std::lock_guard<std::mutex> guard(read_policy_lock_);
+    if (consistency == read_consistency::lease) {
+        return {leader_id_, read_policy_};
+    }
+
+    if (read_policy_ == nullptr) {
+        throw std::runtime_error(
+            "manual read policy specified and no server specified.");
+    }
+    return {read_policy_->next_server(key), read_policy_};
+}
+
+// Whether `result` names a leader other than the server that answered.
+static bool has_leader_hint(const rpc_mutation_result& result, int32_t tried) {
+    return result.leader_id() != GET_LEADER_NO_LIVE_LEADER &&
+           result.leader_id() != tried;
+}
+
+bool client::try_handle_leader_change(const rpc_mutation_result& result,
+                                      int32_t tried) {
+    if (result.raft_rc() != CMD_RESULT_NOT_LEADER &&
+        result.raft_rc() != CMD_RESULT_REQUEST_CANCELLED) {
+        return false;
+    }
+
+    // Without a hint the election is still running, so ask around until a
+    // leader emerges.
+    int32_t new_leader = has_leader_hint(result, tried) ? result.leader_id()
+                                                        : get_leader_id();
+
+    bool known;
+    {
+        std::shared_lock<std::shared_mutex> guard(clients_lock_);
+        known = clients_.count(new_leader) > 0;
+    }
+    if (!known) {
+        // The leader joined after the client last fetched the servers.
+        refresh_membership();
+    }
+
+    // Other threads may have followed the change already, and possibly a
+    // later one too, so only replace the leader this request used.
+    int32_t expected = tried;
+    if (leader_id_.compare_exchange_strong(expected, new_leader) &&
+        print_errors_) {
+        std::cerr << "INFO: leader changed from " << tried << " to "
+                  << new_leader << std::endl;
+    }
+    return true;
+}
+
+rpc_read_result client::get(const string& key, std::optional<int32_t> server,
+                            read_consistency consistency) {
+    read_route route = server.has_value()
+                           ? read_route{*server, current_read_policy()}
+                           : pick_read_server(key, consistency);
+
+    auto call = [&](int32_t srv) {
+        read_timer timer{route.policy_, srv};
+        return connection(srv)
+            ->call(RPC_SPLINTERDB_GET, key, static_cast<uint8_t>(consistency))
+            .as<rpc_read_result>();
+    };
+
+    if (!server.has_value() && consistency != read_consistency::lease &&
+        hedge_percentile_.load(std::memory_order_relaxed) > 0) {
+        return hedged_get(key, route, consistency);
+    }
+
+    rpc_read_result result = call(route.server_);
+    if (result.rc() == READ_RC_NOT_LEADER && !server.has_value()) {
+        // Lease reads follow a leader change once.
         leader_id_ = get_leader_id();
+        result = call(leader_id_);
+    }
+    return result;
+}
 
-        if (print_errors_) {
-            std::cerr << "INFO: leader changed from " << old_leader_id << " to "
-                      << leader_id_ << std::endl;
+void client::set_hedged_reads(double percentile,
+                              std::chrono::microseconds min_delay) {
+    if (percentile < 0 || percentile >= 1) {
+        throw std::invalid_argument("hedging percentile must be in [0, 1)");
+    }
+    hedge_min_delay_us_ = min_delay.count();
+    hedge_percentile_ = percentile;
+}
+
+void client::watch_read(pending_read&& read,
+                        std::shared_ptr<hedge_outcome> outcome,
+                        std::chrono::steady_clock::time_point deadline) {
+    auto watch = [this, read = std::move(read), outcome = std::move(outcome),
+                  deadline]() mutable {
+        std::optional<rpc_read_result> result;
+        std::exception_ptr error;
+        if (read.response_.wait_until(deadline) ==
+            std::future_status::ready) {
+            try {
+                result = read.response_.get().as<rpc_read_result>();
+            } catch (const std::exception& e) {
+                if (print_errors_) {
+                    std::cerr << "WARNING: read from " << read.server_
+                              << " failed: " << e.what() << std::endl;
+                }
+                error = std::current_exception();
+            }
+        }
+        read.timer_.stop();
+
+        {
+            std::lock_guard<std::mutex> guard(outcome->lock_);
+            if (result.has_value()) {
+                if (!outcome->result_.has_value()) {
+                    outcome->result_ = std::move(result);
+                }
+            } else {
+                ++outcome->failed_;
+                if (error != nullptr) {
+                    outcome->error_ = error;
+                }
+            }
         }
-        return true;
+        outcome->cv_.notify_all();
+    };
+
+    std::future<void> watcher =
+        std::async(std::launch::async, std::move(watch));
+
+    std::lock_guard<std::mutex> guard(read_watchers_lock_);
+    read_watchers_.erase(
+        std::remove_if(read_watchers_.begin(), read_watchers_.end(),
+                       [](const std::future<void>& w) {
+                           return w.wait_for(std::chrono::seconds(0)) ==
+                                  std::future_status::ready;
+                       }),
+        read_watchers_.end());
+    read_watchers_.push_back(std::move(watcher));
+}
+
+rpc_read_result client::hedged_get(const string& key,
+                                   const read_route& primary,
+                                   read_consistency consistency) {
+    auto send = [&](int32_t srv) {
+        connection_pool::lease conn = connection(srv);
+        read_timer timer{primary.policy_, srv};
+        auto response = conn->async_call(RPC_SPLINTERDB_GET, key,
+                                         static_cast<uint8_t>(consistency));
+        return pending_read{srv, std::move(conn), std::move(timer),
+                            std::move(response)};
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    auto deadline = start + std::chrono::milliseconds(timeout_ms_);
+    auto delay = std::max(
+        read_latencies_.percentile(hedge_percentile_.load()),
+        std::chrono::microseconds(hedge_min_delay_us_.load()));
+
+    pending_read first = send(primary.server_);
+    if (first.response_.wait_for(delay) == std::future_status::ready) {
+        first.timer_.stop();
+        read_latencies_.record(std::chrono::steady_clock::now() - start);
+        return first.response_.get().as<rpc_read_result>();
+    }
+
+    int32_t alternate;
+    {
+        std::lock_guard<std::mutex> guard(read_policy_lock_);
+        alternate = primary.policy_->alternate_server(key, primary.server_);
+    }
+
+    // rpclib's futures cannot be waited on together, so each read is
+    // waited on by a task of its own. Only tail reads get here.
+    auto outcome = std::make_shared<hedge_outcome>();
+    size_t sent = 1;
+    watch_read(std::move(first), outcome, deadline);
+    if (alternate != primary.server_) {
+        watch_read(send(alternate), outcome, deadline);
+        ++sent;
     }
 
-    return false;
+    std::unique_lock<std::mutex> guard(outcome->lock_);
+    outcome->cv_.wait_until(guard, deadline, [&] {
+        return outcome->result_.has_value() || outcome->failed_ == sent;
+    });
+    // A slow primary still counts towards the hedging delay, with how long
+    // it had taken so far.
+    read_latencies_.record(std::chrono::steady_clock::now() - start);
+    if (outcome->result_.has_value()) {
+        return std::move(*outcome->result_);
+    }
+    if (outcome->failed_ == sent && outcome->error_ != nullptr) {
+        std::rethrow_exception(outcome->error_);
+    }
+    throw std::runtime_error("read of \"" + key + "\" timed out after " +
+                             std::to_string(timeout_ms_) + " ms");
 }
 
-rpc_read_result client::get(const string& key, std::optional<int32_t> server) {
-    int32_t target_server = 0;
-    if (server.has_value()) {
-        target_server = *server;
-    } else if (read_policy_ != nullptr) {
-        target_server = read_policy_->next_server(key);
-    } else {
-        throw std::runtime_error("manual read policy specified and no server specified.");
+rpc_multi_read_result client::multi_get(const std::vector<string>& keys,
+                                        read_consistency consistency) {
+    // Positions in `keys` of the keys sent to each server.
+    std::map<int32_t, std::vector<size_t>> by_server;
+    // The policy the keys were routed by, which the batches report to.
+    std::shared_ptr<read_policy> policy;
+    for (size_t i = 0; i < keys.size(); ++i) {
+        read_route route = pick_read_server(keys[i], consistency);
+        by_server[route.server_].push_back(i);
+        policy = std::move(route.policy_);
     }
 
-    return clients_.find(target_server)->second.call(RPC_SPLINTERDB_GET, key)
-        .as<rpc_read_result>();
+    struct pending_batch {
+        const std::vector<size_t>* positions_;
+        connection_pool::lease conn_;
+        read_timer timer_;
+        std::future<RPCLIB_MSGPACK::object_handle> response_;
+    };
+
+    std::vector<pending_batch> pending;
+    pending.reserve(by_server.size());
+    for (const auto& [srv, positions] : by_server) {
+        std::vector<string> batch;
+        batch.reserve(positions.size());
+        for (size_t i : positions) {
+            batch.push_back(keys[i]);
+        }
+
+        connection_pool::lease conn = connection(srv);
+        read_timer timer{policy, srv};
+        auto response =
+            conn->async_call(RPC_SPLINTERDB_MULTI_GET, std::move(batch),
+                             static_cast<uint8_t>(consistency));
+        pending.push_back({&positions, std::move(conn), std::move(timer),
+                           std::move(response)});
+    }
+
+    rpc_multi_read_result results{keys.size()};
+    for (auto& [positions, conn, timer, response] : pending) {
+        auto batch_results = response.get().as<rpc_multi_read_result>();
+        timer.stop();
+        for (size_t j = 0; j < positions->size(); ++j) {
+            size_t i = (*positions)[j];
+            results.set_rc(i, batch_results.rc(j));
+            results.value(i) = std::move(batch_results.value(j));
+        }
+    }
+
+    return results;
+}
+
+int32_t client::scan(const string& start_key, const string& end_key,
+                     const scan_callback& on_page, uint32_t page_size,
+                     read_consistency consistency) {
+    int32_t target_server = pick_read_server(start_key, consistency).server_;
+    string next_key = start_key;
+    while (true) {
+        auto page = connection(target_server)
+                        ->call(RPC_SPLINTERDB_SCAN, next_key, end_key,
+                               page_size, static_cast<uint8_t>(consistency))
+                        .as<rpc_scan_result>();
+        if (page.rc() != 0) {
+            return page.rc();
+        }
+
+        if (!on_page(page) || !page.has_more()) {
+            return 0;
+        }
+        next_key = page.resume_key();
+    }
+}
+
+int32_t client::prefix_scan(const string& prefix, const scan_callback& on_page,
+                            uint32_t page_size, read_consistency consistency) {
+    // The smallest key above every key with this prefix: drop trailing 0xff
+    // bytes and increment the last one. No such key exists if the prefix is
+    // all 0xff, so scan to the end.
+    string end_key = prefix;
+    while (!end_key.empty() && static_cast<uint8_t>(end_key.back()) == 0xff) {
+        end_key.pop_back();
+    }
+    if (!end_key.empty()) {
+        end_key.back() = static_cast<char>(end_key.back() + 1);
+    }
+
+    return scan(prefix, end_key, on_page, page_size, consistency);
 }
 
 rpc_mutation_result client::retry_mutation(
-    const string& key, std::function<rpc_mutation_result()> f) {
+    const string& key,
+    const std::function<rpc_mutation_result(rpc::client&)>& f) {
     rpc_mutation_result result;
     size_t delay_ms = 100;
     for (uint16_t i = 0; i < num_retries_; ++i) {
-        result = f();
+        int32_t leader = leader_id_;
+        result = f(*connection(leader));
 
         if (result.was_accepted()) {
             break;
@@ -162,13 +583,18 @@ rpc_mutation_result client::retry_mutation(
             std::cout << "WARNING: weird case. Verify that kvp was mutated: "
                       << key << std::endl;
             break;
-        } else if (try_handle_leader_change(result.raft_rc())) {
+        } else if (try_handle_leader_change(result, leader)) {
             if (print_errors_) {
                 std::cerr << "WARNING: leader changed, retrying..."
                           << std::endl;
             }
-            std::this_thread::sleep_for(std::chrono::milliseconds(delay_ms));
-            delay_ms *= 2;
+            // A follower that knows the new leader is redirected to at
+            // once; only back off while there is none.
+            if (!has_leader_hint(result, leader)) {
+                std::this_thread::sleep_for(
+                    std::chrono::milliseconds(delay_ms));
+                delay_ms *= 2;
+            }
         }
     }
 
@@ -176,32 +602,97 @@ rpc_mutation_result client::retry_mutation(
 }
 
 rpc_mutation_result client::put(const string& key, const string& value) {
-    rpc::client& cl = get_leader_handle();
-    return retry_mutation(key, [&cl, key, value]() {
+    return retry_mutation(key, [&key, &value](rpc::client& cl) {
         return cl.call(RPC_SPLINTERDB_PUT, key, value)
             .as<rpc_mutation_result>();
     });
 }
 
 rpc_mutation_result client::update(const string& key, const string& value) {
-    rpc::client& cl = get_leader_handle();
-    return retry_mutation(key, [&cl, key, value]() {
+    return retry_mutation(key, [&key, &value](rpc::client& cl) {
         return cl.call(RPC_SPLINTERDB_UPDATE, key, value)
             .as<rpc_mutation_result>();
     });
 }
 
 rpc_mutation_result client::del(const std::string& key) {
-    rpc::client& cl = get_leader_handle();
-    return retry_mutation(key, [&cl, key]() {
+    return retry_mutation(key, [&key](rpc::client& cl) {
         return cl.call(RPC_SPLINTERDB_DELETE, key).as<rpc_mutation_result>();
     });
 }
 
+rpc_mutation_result client::write_batch(const rpc_write_batch& batch) {
+    string desc = "<batch of " + std::to_string(batch.size()) + " ops>";
+    return retry_mutation(desc, [&batch](rpc::client& cl) {
+        return cl.call(RPC_SPLINTERDB_WRITE_BATCH, batch)
+            .as<rpc_mutation_result>();
+    });
+}
+
+std::future<rpc_read_result> client::async_get(const string& key,
+                                              read_consistency consistency) {
+    read_route route = pick_read_server(key, consistency);
+    connection_pool::lease conn = connection(route.server_);
+    read_timer timer{std::move(route.policy_), route.server_};
+    auto response = conn->async_call(RPC_SPLINTERDB_GET, key,
+                                     static_cast<uint8_t>(consistency));
+
+    // Deferred, so the response is decoded on the thread that waits for it
+    // rather than on a thread of its own. The request counts against its
+    // connection until then.
+    return std::async(std::launch::deferred,
+                      [this, key, consistency, conn = std::move(conn),
+                       timer = std::move(timer),
+                       response = std::move(response)]() mutable {
+                          auto result = response.get().as<rpc_read_result>();
+                          timer.stop();
+                          if (result.rc() == READ_RC_NOT_LEADER) {
+                              return get(key, std::nullopt, consistency);
+                          }
+                          return result;
+                      });
+}
+
+std::future<rpc_mutation_result> client::async_put(const string& key,
+                                                   const string& value) {
+    int32_t leader = leader_id_;
+    connection_pool::lease conn = connection(leader);
+    auto response = conn->async_call(RPC_SPLINTERDB_PUT, key, value);
+    return std::async(
+        std::launch::deferred,
+        [this, key, value, leader, conn = std::move(conn),
+         response = std::move(response)]() mutable {
+            auto result = response.get().as<rpc_mutation_result>();
+            if (!result.was_accepted() &&
+                try_handle_leader_change(result, leader)) {
+                return put(key, value);
+            }
+            return result;
+        });
+}
+
+std::future<rpc_mutation_result> client::async_del(const string& key) {
+    int32_t leader = leader_id_;
+    connection_pool::lease conn = connection(leader);
+    auto response = conn->async_call(RPC_SPLINTERDB_DELETE, key);
+    return std::async(
+        std::launch::deferred,
+        [this, key, leader, conn = std::move(conn),
+         response = std::move(response)]() mutable {
+            auto result = response.get().as<rpc_mutation_result>();
+            if (!result.was_accepted() &&
+                try_handle_leader_change(result, leader)) {
+                return del(key);
+            }
+            return result;
+        });
+}
+
 rpc_cluster_endpoints client::get_all_servers() {
-    for (auto& [srv_id, c] : clients_) {
+    for (auto& [srv_id, pool] : all_pools()) {
         try {
-            return c.call(RPC_GET_ALL_SERVERS)
+            return pool->acquire()
+                ->call(RPC_GET_ALL_SERVERS)
                 .as<rpc_cluster_endpoints>();
         } catch (const std::exception& e) {
             std::cerr << "WARNING: failed to connect to " << srv_id
@@ -215,10 +706,11 @@ rpc_cluster_endpoints client::get_all_servers() {
 
 int32_t client::get_leader_id() {
     size_t delay_ms = 100;
-    for (auto& [srv_id, c] : clients_) {
+    for (auto& [srv_id, pool] : all_pools()) {
         try {
             for (uint16_t i = 0; i < num_retries_; ++i) {
-                int32_t leader_id = c.call(RPC_GET_LEADER_ID).as<int32_t>();
+                int32_t leader_id =
+                    pool->acquire()->call(RPC_GET_LEADER_ID).as<int32_t>();
                 if (leader_id != GET_LEADER_NO_LIVE_LEADER) {
                     return leader_id;
                 }
@@ -250,9 +742,111 @@ int32_t client::get_leader_id() {
 
 void client::set_fixed_key_mapping(std::unordered_map<string, size_t>&& m) {
     if (algo_ == read_policy::algorithm::fixed) {
+        std::lock_guard<std::mutex> guard(read_policy_lock_);
         auto frp = static_cast<fixed_read_policy*>(read_policy_.get());
         frp->set_mapping(std::forward<std::unordered_map<string, size_t>>(m));
     }
 }
 
+std::vector<std::pair<string, uint64_t>> client::get_hot_keys(size_t limit) {
+    // Each replica only sees the lookups routed to it, so the counts are
+    // summed.
+    std::unordered_map<string, uint64_t> counts;
+    auto checked_limit = static_cast<uint32_t>(
+        std::min<size_t>(limit, std::numeric_limits<uint32_t>::max()));
+    for (auto& [srv_id, pool] : all_pools()) {
+        try {
+            auto hot = pool->acquire()
+                           ->call(RPC_SPLINTERDB_HOT_KEYS, checked_limit)
+                           .as<rpc_hot_keys>();
+            for (size_t i = 0; i < hot.size(); ++i) {
+                counts[hot.key(i)] += hot.count(i);
+            }
+        } catch (const std::exception& e) {
+            std::cerr << "WARNING: failed to get hot keys from " << srv_id
+                      << " ... skipping. Reason: " << e.what() << std::endl;
+        }
+    }
+
+    std::vector<std::pair<string, uint64_t>> result(counts.begin(),
+                                                    counts.end());
+    limit = std::min(limit, result.size());
+    std::partial_sort(
+        result.begin(), result.begin() + static_cast<std::ptrdiff_t>(limit),
+        result.end(),
+        [](const auto& a, const auto& b) { return a.second > b.second; });
+    result.resize(limit);
+    return result;
+}
+
+bool client::rebalance_fixed_mapping(size_t num_keys) {
+    if (algo_ != read_policy::algorithm::fixed) {
+        return false;
+    }
+
+    std::vector<std::pair<string, uint64_t>> hot = get_hot_keys(num_keys);
+
+    std::lock_guard<std::mutex> guard(read_policy_lock_);
+    auto frp = static_cast<fixed_read_policy*>(read_policy_.get());
+    const fixed_read_policy::mapping& current = frp->get_mapping();
+    // Targets index the servers the policy was built with, which can differ
+    // from `member_ids_` once membership changes.
+    size_t num_servers = frp->num_servers();
+    if (num_servers == 0) {
+        return false;
+    }
+
+    uint64_t total = 0;
+    for (const auto& [key, count] : hot) {
+        total += count;
+    }
+    // A replica may take up to a quarter more than an even share before
+    // keys already mapped to it are moved elsewhere.
+    uint64_t max_load = total * 5 / (4 * num_servers);
+
+    // Hottest keys first, each to its current replica if that stays under
+    // `max_load`, and to the least loaded replica otherwise.
+    std::vector<uint64_t> loads(num_servers, 0);
+    fixed_read_policy::mapping balanced;
+    for (auto& [key, count] : hot) {
+        auto it = current.find(key);
+        size_t target;
+        if (it != current.end() && it->second < num_servers &&
+            loads[it->second] + count <= max_load) {
+            target = it->second;
+        } else {
+            target = static_cast<size_t>(
+                std::min_element(loads.begin(), loads.end()) - loads.begin());
+        }
+
+        loads[target] += count;
+        balanced.emplace(std::move(key), target);
+    }
+
+    frp->set_mapping(std::move(balanced));
+    return true;
+}
+
+void client::start_rebalancing(std::chrono::milliseconds interval,
+                               size_t num_keys) {
+    if (rebalancer_.joinable()) {
+        throw std::runtime_error("rebalancing has already been started");
+    }
+
+    rebalancer_ = std::thread([this, interval, num_keys] {
+        std::unique_lock<std::mutex> lock(rebalancer_lock_);
+        while (!rebalancer_cv_.wait_for(lock, interval,
+                                        [this] { return stop_rebalancer_; })) {
+            lock.unlock();
+            try {
+                rebalance_fixed_mapping(num_keys);
+            } catch (const std::exception& e) {
+                std::cerr << "WARNING: failed to rebalance read mapping: "
+                          << e.what() << std::endl;
+            }
+            lock.lock();
+        }
+    });
+}
+
 }  // namespace replicated_splinterdb
\ No newline at end of file
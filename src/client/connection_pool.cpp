@@ -0,0 +1,48 @@
+#include "replicated-splinterdb/client/connection_pool.h"
+
+#include <stdexcept>
+
+namespace replicated_splinterdb {
+
+connection_pool::connection_pool(const std::string& host, uint16_t port,
+                                 size_t size, int64_t timeout_ms)
+    : host_(host),
+      port_(port),
+      timeout_ms_(timeout_ms),
+      slots_(size),
+      lock_() {
+    if (size == 0) {
+        throw std::invalid_argument("connection pool size cannot be 0");
+    }
+}
+
+static bool is_broken(const rpc::client& conn) {
+    auto state = conn.get_connection_state();
+    return state == rpc::client::connection_state::disconnected ||
+           state == rpc::client::connection_state::reset;
+}
+
+connection_pool::lease connection_pool::acquire() {
+    std::lock_guard<std::mutex> guard(lock_);
+
+    // Ties go to the lowest slot, so a new connection is only opened once
+    // every open one is busy.
+    slot* best = &slots_[0];
+    for (auto& s : slots_) {
+        if (s.outstanding_ < best->outstanding_) {
+            best = &s;
+        }
+    }
+
+    if (best->conn_ == nullptr || is_broken(*best->conn_)) {
+        // Requests still holding the old connection keep it alive until
+        // they are done with it.
+        best->conn_ = std::make_shared<rpc::client>(host_, port_);
+        best->conn_->set_timeout(timeout_ms_);
+    }
+
+    ++best->outstanding_;
+    return lease{best->conn_, &best->outstanding_};
+}
+
+}  // namespace replicated_splinterdb
@@ -0,0 +1,81 @@
+#include "replicated-splinterdb/client/latency_histogram.h"
+
+#include <algorithm>
+
+namespace replicated_splinterdb {
+
+latency_histogram::latency_histogram(uint64_t window)
+    : window_(std::max<uint64_t>(window, 1)), buckets_(), samples_(0) {
+    for (auto& b : buckets_) {
+        b.store(0, std::memory_order_relaxed);
+    }
+}
+
+size_t latency_histogram::bucket_of(uint64_t latency_us) {
+    if (latency_us == 0) {
+        return 0;
+    }
+
+    auto msb = static_cast<size_t>(63 - __builtin_clzll(latency_us));
+    // The two bits below the most significant one pick the quarter.
+    size_t quarter = static_cast<size_t>((latency_us << 2) >> msb) & 3;
+    return std::min(msb * 4 + quarter + 1, NUM_BUCKETS - 1);
+}
+
+uint64_t latency_histogram::bucket_upper_bound_us(size_t bucket) {
+    if (bucket == 0) {
+        return 1;
+    }
+
+    size_t msb = (bucket - 1) / 4;
+    size_t quarter = (bucket - 1) % 4;
+    return ((uint64_t{5 + quarter} << msb) + 3) / 4;
+}
+
+void latency_histogram::record(std::chrono::nanoseconds latency) {
+    auto latency_us =
+        std::chrono::duration_cast<std::chrono::microseconds>(latency).count();
+    size_t bucket =
+        bucket_of(static_cast<uint64_t>(std::max<int64_t>(latency_us, 0)));
+    buckets_[bucket].fetch_add(1, std::memory_order_relaxed);
+
+    if ((samples_.fetch_add(1, std::memory_order_relaxed) + 1) % window_ ==
+        0) {
+        decay();
+    }
+}
+
+std::chrono::microseconds latency_histogram::percentile(double p) const {
+    std::array<uint64_t, NUM_BUCKETS> counts;
+    uint64_t total = 0;
+    for (size_t i = 0; i < NUM_BUCKETS; ++i) {
+        counts[i] = buckets_[i].load(std::memory_order_relaxed);
+        total += counts[i];
+    }
+
+    if (total == 0) {
+        return std::chrono::microseconds(0);
+    }
+
+    auto rank = static_cast<uint64_t>(p * static_cast<double>(total));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < NUM_BUCKETS; ++i) {
+        seen += counts[i];
+        if (seen > rank || seen == total) {
+            return std::chrono::microseconds(
+                static_cast<int64_t>(bucket_upper_bound_us(i)));
+        }
+    }
+    return std::chrono::microseconds(
+        static_cast<int64_t>(bucket_upper_bound_us(NUM_BUCKETS - 1)));
+}
+
+void latency_histogram::decay() {
+    // Racing samples may be lost, which the estimate can afford.
+    for (auto& b : buckets_) {
+        b.store(b.load(std::memory_order_relaxed) / 2,
+                std::memory_order_relaxed);
+    }
+}
+
+}  // namespace replicated_splinterdb
@@ -1,15 +1,174 @@
 #include "replicated-splinterdb/client/read_policy.h"
 
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <tuple>
+
 #include "MurmurHash3.h"
 
 #define MMHSEED 1234567890U
 
+// Weight of the newest sample in the latency EWMA.
+#define LATENCY_EWMA_ALPHA 0.2
+
+// An unused replica's latency estimate halves every this many nanoseconds.
+#define LATENCY_HALF_LIFE_NS 1000000000.0
+
 namespace replicated_splinterdb {
 
-uint32_t hash_read_policy::get_token(const std::string& k) {
+static uint32_t hash_bytes(const void* data, size_t len) {
     uint32_t hash;
-    MurmurHash3_x86_32(k.data(), static_cast<int>(k.size()), MMHSEED, &hash);
+    MurmurHash3_x86_32(data, static_cast<int>(len), MMHSEED, &hash);
     return hash;
 }
 
+// Index of the first element of the sorted `values` that is >= `target`,
+// or `values.size()` if there is none. The loop has a fixed trip count for
+// a given size and the comparison compiles to a conditional move, so it
+// does not suffer branch mispredictions on random keys.
+static size_t lower_bound_branchless(const std::vector<uint32_t>& values,
+                                     uint32_t target) {
+    if (values.empty()) {
+        return 0;
+    }
+
+    const uint32_t* base = values.data();
+    size_t len = values.size();
+    while (len > 1) {
+        size_t half = len / 2;
+        base = base[half - 1] < target ? base + half : base;
+        len -= half;
+    }
+    return static_cast<size_t>(base - values.data()) + (*base < target);
+}
+
+hash_read_policy::hash_read_policy(const std::vector<int32_t>& server_ids,
+                                   size_t num_tokens)
+    : read_policy(server_ids), ring_(), owners_() {
+    if (num_tokens == 0) {
+        throw std::invalid_argument("num_tokens cannot be 0");
+    }
+
+    // (position, server ID, server index), so that the ring does not depend
+    // on the order of `server_ids`, even when two virtual nodes collide.
+    std::vector<std::tuple<uint32_t, int32_t, size_t>> vnodes;
+    vnodes.reserve(server_ids.size() * num_tokens);
+    for (size_t idx = 0; idx < server_ids.size(); ++idx) {
+        for (uint32_t vnode = 0; vnode < num_tokens; ++vnode) {
+            int32_t seed[2] = {server_ids[idx], static_cast<int32_t>(vnode)};
+            vnodes.emplace_back(hash_bytes(seed, sizeof(seed)), server_ids[idx],
+                                idx);
+        }
+    }
+    std::sort(vnodes.begin(), vnodes.end());
+
+    ring_.reserve(vnodes.size());
+    owners_.reserve(vnodes.size());
+    for (const auto& [position, srv_id, idx] : vnodes) {
+        ring_.push_back(position);
+        owners_.push_back(idx);
+    }
+}
+
+size_t hash_read_policy::next(const std::string& key) {
+    size_t vnode =
+        lower_bound_branchless(ring_, hash_bytes(key.data(), key.size()));
+    // Past the last virtual node, the ring wraps around to the first.
+    return owners_[vnode == ring_.size() ? 0 : vnode];
+}
+
+size_t hash_read_policy::alternate(const std::string& key, size_t primary) {
+    size_t vnode =
+        lower_bound_branchless(ring_, hash_bytes(key.data(), key.size()));
+    for (size_t i = 0; i < ring_.size(); ++i) {
+        size_t owner = owners_[(vnode + i) % ring_.size()];
+        if (owner != primary) {
+            return owner;
+        }
+    }
+    return read_policy::alternate(key, primary);
+}
+
+static int64_t steady_now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+latency_aware_read_policy::latency_aware_read_policy(
+    const std::vector<int32_t>& server_ids, size_t num_tokens, double slack)
+    : hash_read_policy(server_ids, num_tokens),
+      slack_(slack),
+      stats_(std::make_unique<server_stats[]>(server_ids.size())),
+      indexes_(),
+      rng_() {
+    for (size_t i = 0; i < server_ids.size(); ++i) {
+        indexes_.emplace(server_ids[i], i);
+    }
+
+    std::random_device r;
+    rng_.seed(r());
+}
+
+latency_aware_read_policy::server_stats* latency_aware_read_policy::stats_for(
+    int32_t server_id) {
+    auto idx = indexes_.find(server_id);
+    return idx == indexes_.end() ? nullptr : &stats_[idx->second];
+}
+
+void latency_aware_read_policy::on_request_start(int32_t server_id) {
+    if (server_stats* stats = stats_for(server_id)) {
+        ++stats->outstanding_;
+    }
+}
+
+void latency_aware_read_policy::on_request_end(
+    int32_t server_id, std::chrono::nanoseconds latency) {
+    server_stats* stats = stats_for(server_id);
+    if (stats == nullptr) {
+        return;
+    }
+
+    --stats->outstanding_;
+
+    auto sample = static_cast<double>(latency.count());
+    uint64_t prev = stats->ewma_ns_.load();
+    uint64_t next;
+    do {
+        next = prev == 0 ? static_cast<uint64_t>(sample)
+                         : static_cast<uint64_t>(
+                               LATENCY_EWMA_ALPHA * sample +
+                               (1 - LATENCY_EWMA_ALPHA) *
+                                   static_cast<double>(prev));
+    } while (!stats->ewma_ns_.compare_exchange_weak(prev, next));
+    stats->updated_ns_ = steady_now_ns();
+}
+
+double latency_aware_read_policy::score(size_t idx, int64_t now_ns) const {
+    const server_stats& stats = stats_[idx];
+    auto age = static_cast<double>(now_ns - stats.updated_ns_.load());
+    double ewma = static_cast<double>(stats.ewma_ns_.load()) *
+                  std::exp2(-age / LATENCY_HALF_LIFE_NS);
+    return ewma * (1 + stats.outstanding_.load());
+}
+
+size_t latency_aware_read_policy::next(const std::string& key) {
+    size_t home = hash_read_policy::next(key);
+    if (num_servers() < 2) {
+        return home;
+    }
+
+    // Pick any replica but the home one.
+    std::uniform_int_distribution<size_t> distr(0, num_servers() - 2);
+    size_t other = distr(rng_);
+    if (other >= home) {
+        ++other;
+    }
+
+    int64_t now_ns = steady_now_ns();
+    return score(other, now_ns) * (1 + slack_) < score(home, now_ns) ? other
+                                                                     : home;
+}
+
 }  // namespace replicated_splinterdb
@@ -0,0 +1,147 @@
+#include "hot_key_sketch.h"
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <mutex>
+
+namespace replicated_splinterdb {
+
+hot_key_sketch::hot_key_sketch(size_t capacity, size_t width,
+                               uint64_t decay_interval)
+    : capacity_(capacity),
+      width_(std::max<size_t>(width, 1)),
+      decay_interval_(std::max<uint64_t>(decay_interval, 1)),
+      counters_(DEPTH * width_),
+      records_(0),
+      admit_threshold_(0),
+      tracked_(),
+      tracked_lock_() {}
+
+void hot_key_sketch::record(std::string_view key) {
+    uint64_t hash = std::hash<std::string_view>{}(key);
+    uint64_t count = add(hash);
+
+    if (count >= admit_threshold_.load(std::memory_order_relaxed)) {
+        bool tracked;
+        {
+            std::shared_lock<std::shared_mutex> guard(tracked_lock_);
+            tracked = tracked_.count(hash) > 0;
+        }
+
+        if (!tracked) {
+            admit(hash, key, count);
+        }
+    }
+
+    if ((records_.fetch_add(1, std::memory_order_relaxed) + 1) %
+            decay_interval_ ==
+        0) {
+        decay();
+    }
+}
+
+std::vector<std::pair<std::string, uint64_t>> hot_key_sketch::top(
+    size_t limit) const {
+    std::vector<std::pair<std::string, uint64_t>> result;
+    {
+        std::shared_lock<std::shared_mutex> guard(tracked_lock_);
+        result.reserve(tracked_.size());
+        for (const auto& [hash, key] : tracked_) {
+            result.emplace_back(key, estimate(hash));
+        }
+    }
+
+    limit = std::min(limit, result.size());
+    std::partial_sort(
+        result.begin(), result.begin() + static_cast<std::ptrdiff_t>(limit),
+        result.end(),
+        [](const auto& a, const auto& b) { return a.second > b.second; });
+    result.resize(limit);
+    return result;
+}
+
+size_t hot_key_sketch::counter_index(uint64_t hash, size_t row) const {
+    // Double hashing: row i uses h1 + i * h2, with h2 odd.
+    uint64_t h1 = hash & 0xffffffff;
+    uint64_t h2 = (hash >> 32) | 1;
+    return row * width_ + static_cast<size_t>((h1 + row * h2) % width_);
+}
+
+uint64_t hot_key_sketch::add(uint64_t hash) {
+    uint64_t count = std::numeric_limits<uint64_t>::max();
+    for (size_t row = 0; row < DEPTH; ++row) {
+        uint32_t c = counters_[counter_index(hash, row)].fetch_add(
+                         1, std::memory_order_relaxed) +
+                     1;
+        count = std::min<uint64_t>(count, c);
+    }
+    return count;
+}
+
+uint64_t hot_key_sketch::estimate(uint64_t hash) const {
+    uint64_t count = std::numeric_limits<uint64_t>::max();
+    for (size_t row = 0; row < DEPTH; ++row) {
+        count = std::min<uint64_t>(
+            count, counters_[counter_index(hash, row)].load(
+                       std::memory_order_relaxed));
+    }
+    return count;
+}
+
+void hot_key_sketch::admit(uint64_t hash, std::string_view key,
+                           uint64_t count) {
+    if (capacity_ == 0) {
+        return;
+    }
+
+    std::unique_lock<std::shared_mutex> guard(tracked_lock_);
+    if (tracked_.count(hash) > 0) {
+        return;
+    }
+
+    if (tracked_.size() < capacity_) {
+        tracked_.emplace(hash, std::string(key));
+        if (tracked_.size() < capacity_) {
+            return;
+        }
+    }
+
+    // Find the coldest tracked key, and the estimate of the next coldest
+    // in case it gets evicted.
+    auto coldest = tracked_.end();
+    uint64_t coldest_count = std::numeric_limits<uint64_t>::max();
+    uint64_t next_count = std::numeric_limits<uint64_t>::max();
+    for (auto it = tracked_.begin(); it != tracked_.end(); ++it) {
+        uint64_t c = estimate(it->first);
+        if (c < coldest_count) {
+            next_count = coldest_count;
+            coldest_count = c;
+            coldest = it;
+        } else if (c < next_count) {
+            next_count = c;
+        }
+    }
+
+    if (coldest->first != hash && count > coldest_count) {
+        tracked_.erase(coldest);
+        tracked_.emplace(hash, std::string(key));
+        coldest_count = std::min(next_count, count);
+    }
+
+    // Only keys hotter than every tracked key can get in.
+    admit_threshold_.store(coldest_count + 1, std::memory_order_relaxed);
+}
+
+void hot_key_sketch::decay() {
+    // Racing increments may be lost, which the estimates can afford.
+    for (auto& c : counters_) {
+        c.store(c.load(std::memory_order_relaxed) / 2,
+                std::memory_order_relaxed);
+    }
+    admit_threshold_.store(
+        admit_threshold_.load(std::memory_order_relaxed) / 2,
+        std::memory_order_relaxed);
+}
+
+}  // namespace replicated_splinterdb
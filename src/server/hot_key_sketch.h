@@ -0,0 +1,83 @@
+#ifndef REPLICATED_SPLINTERDB_HOT_KEY_SKETCH_H
+#define REPLICATED_SPLINTERDB_HOT_KEY_SKETCH_H
+
+#include <atomic>
+#include <cstdint>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace replicated_splinterdb {
+
+/**
+ * Approximate lookup counts of the hottest keys.
+ *
+ * Every lookup bumps a count-min sketch, which over-estimates but never
+ * under-estimates a key's count. Keys whose estimate reaches the smallest
+ * estimate among the `capacity` tracked keys replace it. Once every
+ * `decay_interval` lookups all counts are halved, so the result follows
+ * the current workload.
+ *
+ * Safe to use from several threads. Recording a cold key takes no locks.
+ */
+class hot_key_sketch {
+  public:
+    hot_key_sketch(size_t capacity, size_t width = 4096,
+                   uint64_t decay_interval = 1 << 20);
+
+    hot_key_sketch(const hot_key_sketch&) = delete;
+
+    hot_key_sketch& operator=(const hot_key_sketch&) = delete;
+
+    // Count a lookup of `key`.
+    void record(std::string_view key);
+
+    // Up to `limit` of the tracked keys with their estimated counts,
+    // hottest first.
+    std::vector<std::pair<std::string, uint64_t>> top(size_t limit) const;
+
+  private:
+    static constexpr size_t DEPTH = 4;
+
+    // Bump the counters of `hash` and return its new estimate.
+    uint64_t add(uint64_t hash);
+
+    uint64_t estimate(uint64_t hash) const;
+
+    // Index of the counter for `hash` in the given row.
+    size_t counter_index(uint64_t hash, size_t row) const;
+
+    // Track `key`, evicting the coldest key if it is colder than `count`.
+    void admit(uint64_t hash, std::string_view key, uint64_t count);
+
+    void decay();
+
+    const size_t capacity_;
+
+    const size_t width_;
+
+    const uint64_t decay_interval_;
+
+    // DEPTH rows of `width_` counters.
+    std::vector<std::atomic<uint32_t>> counters_;
+
+    // Lookups recorded so far, to schedule decays.
+    std::atomic<uint64_t> records_;
+
+    // Estimate a key needs to be considered for `tracked_`. Zero until
+    // `tracked_` is full.
+    std::atomic<uint64_t> admit_threshold_;
+
+    // Tracked keys by their hash.
+    std::unordered_map<uint64_t, std::string> tracked_;
+
+    // Mutex for `tracked_`.
+    mutable std::shared_mutex tracked_lock_;
+};
+
+}  // namespace replicated_splinterdb
+
+#endif  // REPLICATED_SPLINTERDB_HOT_KEY_SKETCH_H
@@ -17,23 +17,55 @@ limitations under the License.
 
 #include "in_memory_log_store.h"
 
+#include <algorithm>
 #include <cassert>
+#include <thread>
 
 #include "libnuraft/nuraft.hxx"
 
 namespace nuraft {
 
+// Number of slots the ring starts with.
+static constexpr size_t INITIAL_CAPACITY = 4096;
+
+struct inmem_log_store::read_guard {
+    explicit read_guard(const inmem_log_store& store) : store_(store) {
+        // A writer that flips the epoch between our load and our increment
+        // may have found the old epoch empty already, so count ourselves in
+        // the new one instead.
+        for (;;) {
+            epoch_ = store_.epoch_.load() & 1;
+            store_.readers_[epoch_].fetch_add(1);
+            if ((store_.epoch_.load() & 1) == epoch_) {
+                break;
+            }
+            store_.readers_[epoch_].fetch_sub(1);
+        }
+    }
+
+    ~read_guard() { store_.readers_[epoch_].fetch_sub(1); }
+
+    read_guard(const read_guard&) = delete;
+
+    read_guard& operator=(const read_guard&) = delete;
+
+    const inmem_log_store& store_;
+    uint32_t epoch_;
+};
+
 inmem_log_store::inmem_log_store()
-    : start_idx_(1),
+    : ring_(new ring(INITIAL_CAPACITY)),
+      dummy_(cs_new<log_entry>(0, buffer::alloc(sz_ulong))),
+      start_idx_(1),
+      next_idx_(1),
+      epoch_(0),
+      readers_(),
+      write_lock_(),
       raft_server_bwd_pointer_(nullptr),
       disk_emul_delay(0),
       disk_emul_thread_(nullptr),
       disk_emul_thread_stop_signal_(false),
-      disk_emul_last_durable_index_(0) {
-    // Dummy entry for index 0.
-    ptr<buffer> buf = buffer::alloc(sz_ulong);
-    logs_[0] = cs_new<log_entry>(0, buf);
-}
+      disk_emul_last_durable_index_(0) {}
 
 inmem_log_store::~inmem_log_store() {
     if (disk_emul_thread_) {
@@ -43,6 +75,8 @@ inmem_log_store::~inmem_log_store() {
             disk_emul_thread_->join();
         }
     }
+
+    delete ring_.load();
 }
 
 ptr<log_entry> inmem_log_store::make_clone(const ptr<log_entry>& entry) {
@@ -56,33 +90,99 @@ ptr<log_entry> inmem_log_store::make_clone(const ptr<log_entry>& entry) {
     return clone;
 }
 
-ulong inmem_log_store::next_slot() const {
-    std::lock_guard<std::mutex> l(logs_lock_);
-    // Exclude the dummy entry.
-    return start_idx_ + logs_.size() - 1;
+const ptr<log_entry>& inmem_log_store::find_entry(ulong index) const {
+    // The indexes are loaded before the ring: a log is only published after
+    // the ring holding it, so the ring seen here has every log below `next`.
+    ulong start = start_idx_.load();
+    ulong next = next_idx_.load();
+    if (index < start || index >= next) {
+        return dummy_;
+    }
+
+    // The two indexes are not loaded together, so they may describe a
+    // range that never existed while a writer moves both.
+    const slot& s = ring_.load()->at(index);
+    if (s.entry_ == nullptr || s.index_ != index) {
+        return dummy_;
+    }
+    return s.entry_;
 }
 
-ulong inmem_log_store::start_index() const { return start_idx_; }
+void inmem_log_store::wait_for_readers() {
+    uint32_t old_epoch = epoch_.fetch_add(1) & 1;
+    while (readers_[old_epoch].load() != 0) {
+        std::this_thread::yield();
+    }
+}
 
-ptr<log_entry> inmem_log_store::last_entry() const {
-    ulong next_idx = next_slot();
-    std::lock_guard<std::mutex> l(logs_lock_);
-    auto entry = logs_.find(next_idx - 1);
-    if (entry == logs_.end()) {
-        entry = logs_.find(0);
+void inmem_log_store::clear_slots(ulong begin, ulong end) {
+    ring* r = ring_.load();
+    for (ulong ii = begin; ii < end; ++ii) {
+        r->at(ii).entry_.reset();
     }
+}
 
-    return make_clone(entry->second);
+void inmem_log_store::append_locked(const ptr<log_entry>& entry) {
+    ring* r = ring_.load();
+    ulong start = start_idx_.load();
+    ulong next = next_idx_.load();
+
+    if (next - start >= r->capacity()) {
+        ring* bigger = new ring(r->capacity() * 2);
+        for (ulong ii = start; ii < next; ++ii) {
+            bigger->at(ii) = r->at(ii);
+        }
+
+        ring_.store(bigger);
+        wait_for_readers();
+        delete r;
+        r = bigger;
+    }
+
+    slot& s = r->at(next);
+    s.index_ = next;
+    s.entry_ = entry;
+    next_idx_.store(next + 1);
 }
 
-ulong inmem_log_store::append(ptr<log_entry>& entry) {
-    ptr<log_entry> clone = make_clone(entry);
+void inmem_log_store::truncate_locked(ulong index) {
+    ulong start = start_idx_.load();
+    ulong next = next_idx_.load();
+
+    if (index >= start && index <= next) {
+        if (index == next) {
+            return;
+        }
+        next_idx_.store(index);
+        wait_for_readers();
+        clear_slots(index, next);
+        return;
+    }
+
+    // The log restarts at `index`. Empty it before moving its start.
+    next_idx_.store(std::min(start, index));
+    start_idx_.store(index);
+    next_idx_.store(index);
+    wait_for_readers();
+    clear_slots(start, next);
+}
+
+ulong inmem_log_store::next_slot() const { return next_idx_.load(); }
 
-    std::lock_guard<std::mutex> l(logs_lock_);
-    size_t idx = start_idx_ + logs_.size() - 1;
-    logs_[idx] = clone;
+ulong inmem_log_store::start_index() const { return start_idx_.load(); }
+
+ptr<log_entry> inmem_log_store::last_entry() const {
+    read_guard g(*this);
+    return make_clone(find_entry(next_idx_.load() - 1));
+}
+
+ulong inmem_log_store::append(ptr<log_entry>& entry) {
+    std::lock_guard<std::mutex> l(write_lock_);
+    ulong idx = next_idx_.load();
+    append_locked(entry);
 
     if (disk_emul_delay) {
+        std::lock_guard<std::mutex> el(disk_emul_lock_);
         uint64_t cur_time = timer_helper::get_timeofday_us();
         disk_emul_logs_being_written_[cur_time + disk_emul_delay * 1000] = idx;
         disk_emul_ea_.invoke();
@@ -92,17 +192,13 @@ ulong inmem_log_store::append(ptr<log_entry>& entry) {
 }
 
 void inmem_log_store::write_at(ulong index, ptr<log_entry>& new_entry) {
-    ptr<log_entry> clone = make_clone(new_entry);
-
     // Discard all logs equal to or greater than `index.
-    std::lock_guard<std::mutex> l(logs_lock_);
-    auto itr = logs_.lower_bound(index);
-    while (itr != logs_.end()) {
-        itr = logs_.erase(itr);
-    }
-    logs_[index] = clone;
+    std::lock_guard<std::mutex> l(write_lock_);
+    truncate_locked(index);
+    append_locked(new_entry);
 
     if (disk_emul_delay) {
+        std::lock_guard<std::mutex> el(disk_emul_lock_);
         uint64_t cur_time = timer_helper::get_timeofday_us();
         disk_emul_logs_being_written_[cur_time + disk_emul_delay * 1000] =
             index;
@@ -122,25 +218,7 @@ void inmem_log_store::write_at(ulong index, ptr<log_entry>& new_entry) {
 
 ptr<std::vector<ptr<log_entry>>> inmem_log_store::log_entries(ulong start,
                                                               ulong end) {
-    ptr<std::vector<ptr<log_entry>>> ret =
-        cs_new<std::vector<ptr<log_entry>>>();
-
-    ret->resize(end - start);
-    ulong cc = 0;
-    for (ulong ii = start; ii < end; ++ii) {
-        ptr<log_entry> src = nullptr;
-        {
-            std::lock_guard<std::mutex> l(logs_lock_);
-            auto entry = logs_.find(ii);
-            if (entry == logs_.end()) {
-                entry = logs_.find(0);
-                assert(0);
-            }
-            src = entry->second;
-        }
-        (*ret)[cc++] = make_clone(src);
-    }
-    return ret;
+    return log_entries_ext(start, end, 0);
 }
 
 ptr<std::vector<ptr<log_entry>>> inmem_log_store::log_entries_ext(
@@ -152,18 +230,11 @@ ptr<std::vector<ptr<log_entry>>> inmem_log_store::log_entries_ext(
         return ret;
     }
 
+    read_guard g(*this);
     size_t accum_size = 0;
     for (ulong ii = start; ii < end; ++ii) {
-        ptr<log_entry> src = nullptr;
-        {
-            std::lock_guard<std::mutex> l(logs_lock_);
-            auto entry = logs_.find(ii);
-            if (entry == logs_.end()) {
-                entry = logs_.find(0);
-                assert(0);
-            }
-            src = entry->second;
-        }
+        const ptr<log_entry>& src = find_entry(ii);
+        assert(src != dummy_);
         ret->push_back(make_clone(src));
         accum_size += src->get_buf().size();
         if (batch_size_hint_in_bytes &&
@@ -174,29 +245,13 @@ ptr<std::vector<ptr<log_entry>>> inmem_log_store::log_entries_ext(
 }
 
 ptr<log_entry> inmem_log_store::entry_at(ulong index) {
-    ptr<log_entry> src = nullptr;
-    {
-        std::lock_guard<std::mutex> l(logs_lock_);
-        auto entry = logs_.find(index);
-        if (entry == logs_.end()) {
-            entry = logs_.find(0);
-        }
-        src = entry->second;
-    }
-    return make_clone(src);
+    read_guard g(*this);
+    return make_clone(find_entry(index));
 }
 
 ulong inmem_log_store::term_at(ulong index) {
-    ulong term = 0;
-    {
-        std::lock_guard<std::mutex> l(logs_lock_);
-        auto entry = logs_.find(index);
-        if (entry == logs_.end()) {
-            entry = logs_.find(0);
-        }
-        term = entry->second->get_term();
-    }
-    return term;
+    read_guard g(*this);
+    return find_entry(index)->get_term();
 }
 
 ptr<buffer> inmem_log_store::pack(ulong index, int32 cnt) {
@@ -208,16 +263,17 @@ ptr<buffer> inmem_log_store::pack(ulong index, int32 cnt) {
     ulong count = static_cast<ulong>(cnt);
 
     size_t size_total = 0;
-    for (ulong ii = index; ii < index + count; ++ii) {
-        ptr<log_entry> le = nullptr;
-        {
-            std::lock_guard<std::mutex> l(logs_lock_);
-            le = logs_[ii];
+    {
+        read_guard g(*this);
+        for (ulong ii = index; ii < index + count; ++ii) {
+            const ptr<log_entry>& le = find_entry(ii);
+            assert(le != dummy_);
+            // Serializing resets the buffer's read position, so it is done
+            // on a clone rather than on the shared log.
+            ptr<buffer> buf = make_clone(le)->serialize();
+            size_total += buf->size();
+            logs.push_back(buf);
         }
-        assert(le.get());
-        ptr<buffer> buf = le->serialize();
-        size_total += buf->size();
-        logs.push_back(buf);
     }
 
     ptr<buffer> buf_out =
@@ -241,8 +297,8 @@ void inmem_log_store::apply_pack(ulong index, buffer& pack) {
     }
     ulong num_logs = static_cast<size_t>(nlogs);
 
+    std::vector<ptr<log_entry>> entries;
     for (ulong ii = 0; ii < num_logs; ++ii) {
-        ulong cur_idx = index + ii;
         int32 buf_size = pack.get_int();
 
         if (buf_size < 0) {
@@ -252,39 +308,35 @@ void inmem_log_store::apply_pack(ulong index, buffer& pack) {
         ptr<buffer> buf_local = buffer::alloc(static_cast<size_t>(buf_size));
         pack.get(buf_local);
 
-        ptr<log_entry> le = log_entry::deserialize(*buf_local);
-        {
-            std::lock_guard<std::mutex> l(logs_lock_);
-            logs_[cur_idx] = le;
-        }
+        entries.push_back(log_entry::deserialize(*buf_local));
     }
 
-    {
-        std::lock_guard<std::mutex> l(logs_lock_);
-        auto entry = logs_.upper_bound(0);
-        if (entry != logs_.end()) {
-            start_idx_ = entry->first;
-        } else {
-            start_idx_ = 1;
-        }
+    std::lock_guard<std::mutex> l(write_lock_);
+    truncate_locked(index);
+    for (const auto& le : entries) {
+        append_locked(le);
     }
 }
 
 bool inmem_log_store::compact(ulong last_log_index) {
-    std::lock_guard<std::mutex> l(logs_lock_);
-    for (ulong ii = start_idx_; ii <= last_log_index; ++ii) {
-        auto entry = logs_.find(ii);
-        if (entry != logs_.end()) {
-            logs_.erase(entry);
-        }
-    }
+    std::lock_guard<std::mutex> l(write_lock_);
+    ulong start = start_idx_.load();
+    ulong next = next_idx_.load();
 
     // WARNING:
     //   Even though nothing has been erased,
     //   we should set `start_idx_` to new index.
-    if (start_idx_ <= last_log_index) {
-        start_idx_ = last_log_index + 1;
+    if (start > last_log_index) {
+        return true;
+    }
+
+    start_idx_.store(last_log_index + 1);
+    if (next <= last_log_index) {
+        next_idx_.store(last_log_index + 1);
     }
+
+    wait_for_readers();
+    clear_slots(start, std::min(next, last_log_index + 1));
     return true;
 }
 
@@ -328,7 +380,7 @@ void inmem_log_store::disk_emul_loop() {
 
         bool call_notification = false;
         {
-            std::lock_guard<std::mutex> l(logs_lock_);
+            std::lock_guard<std::mutex> l(disk_emul_lock_);
             // Remove all timestamps equal to or smaller than `cur_time`,
             // and pick the greatest one among them.
             auto entry = disk_emul_logs_being_written_.begin();
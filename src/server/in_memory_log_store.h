@@ -17,8 +17,10 @@ limitations under the License.
 
 #pragma once
 
+#include <array>
 #include <atomic>
 #include <map>
+#include <memory>
 #include <mutex>
 
 #include "libnuraft/event_awaiter.hxx"
@@ -29,6 +31,24 @@ namespace nuraft {
 
 class raft_server;
 
+/**
+ * In-memory log store.
+ *
+ * Logs live in a ring of slots addressed by log index, which grows by
+ * doubling when full. Readers never take a lock: they register in the
+ * current read epoch, read the first and next indexes and the ring, and
+ * copy the slots they need. Appends only write slots outside the readable
+ * range and then publish them by advancing the next index. Writes that
+ * drop readable logs (truncation, compaction, growth) first make them
+ * unreachable, then wait for the readers of the previous epoch to leave
+ * before releasing them. Writers are serialized by `write_lock_`.
+ *
+ * Logs are stored as the very objects Raft appended, without copying their
+ * buffers; Raft does not change a log's contents once it is appended.
+ * Readers get clones, though: Raft resets the read position of the buffers
+ * it serializes, which would race between threads reading the same log.
+ * Cloning only reads the contents, never the position.
+ */
 class inmem_log_store : public log_store {
   public:
     inmem_log_store();
@@ -72,25 +92,106 @@ class inmem_log_store : public log_store {
     void set_disk_delay(raft_server* raft, size_t delay_ms);
 
   private:
+    /**
+     * A log and its index. A reader that raced with a truncation or
+     * compaction may look in a slot that holds another log, so the index
+     * is checked on every read.
+     */
+    struct slot {
+        ulong index_ = 0;
+        ptr<log_entry> entry_;
+    };
+
+    /**
+     * Power-of-two sized array of log slots. Log `i` is in slot
+     * `i & mask_`.
+     */
+    struct ring {
+        explicit ring(size_t capacity)
+            : mask_(capacity - 1), slots_(new slot[capacity]) {}
+
+        slot& at(ulong index) const { return slots_[index & mask_]; }
+
+        size_t capacity() const { return mask_ + 1; }
+
+        const ulong mask_;
+        std::unique_ptr<slot[]> slots_;
+    };
+
+    /**
+     * Registers a reader in the current read epoch for its lifetime.
+     */
+    struct read_guard;
+
     static ptr<log_entry> make_clone(const ptr<log_entry>& entry);
 
+    /**
+     * The log at `index`, or the dummy log if there is none. The caller
+     * must hold a `read_guard` or `write_lock_`.
+     */
+    const ptr<log_entry>& find_entry(ulong index) const;
+
+    /**
+     * Wait until every reader that may still see the state from before the
+     * caller's last store has left. Requires `write_lock_`.
+     */
+    void wait_for_readers();
+
+    /**
+     * Release the logs in [`begin`, `end`), which readers can no longer
+     * reach. Requires `write_lock_`.
+     */
+    void clear_slots(ulong begin, ulong end);
+
+    /**
+     * Append `entry` at `next_idx_`, growing the ring if it is full.
+     * Requires `write_lock_`.
+     */
+    void append_locked(const ptr<log_entry>& entry);
+
+    /**
+     * Drop the logs from `index` on, or all of them and restart the log at
+     * `index` if it is outside the log. Requires `write_lock_`.
+     */
+    void truncate_locked(ulong index);
+
     void disk_emul_loop();
 
     /**
-     * Map of <log index, log data>.
+     * Current ring of logs.
      */
-    std::map<ulong, ptr<log_entry>> logs_;
+    std::atomic<ring*> ring_;
 
     /**
-     * Lock for `logs_`.
+     * Entry returned for indexes outside the log.
      */
-    mutable std::mutex logs_lock_;
+    ptr<log_entry> dummy_;
 
     /**
      * The index of the first log.
      */
     std::atomic<ulong> start_idx_;
 
+    /**
+     * The index of the next log to be appended.
+     */
+    std::atomic<ulong> next_idx_;
+
+    /**
+     * Read epoch. Only its lowest bit is used to pick a reader count.
+     */
+    mutable std::atomic<uint32_t> epoch_;
+
+    /**
+     * Number of readers in each of the two read epochs.
+     */
+    mutable std::array<std::atomic<uint64_t>, 2> readers_;
+
+    /**
+     * Lock serializing appends, truncation and compaction.
+     */
+    std::mutex write_lock_;
+
     /**
      * Backward pointer to Raft server.
      */
@@ -110,6 +211,11 @@ class inmem_log_store : public log_store {
      */
     std::map<uint64_t, uint64_t> disk_emul_logs_being_written_;
 
+    /**
+     * Lock for `disk_emul_logs_being_written_`.
+     */
+    std::mutex disk_emul_lock_;
+
     /**
      * Thread that will update `last_durable_index_` and call
      * `notify_log_append_completion` at proper time.
@@ -0,0 +1,107 @@
+#include "lookup_pool.h"
+
+#include <algorithm>
+
+namespace replicated_splinterdb {
+
+lookup_pool::lookup_pool(size_t num_threads, std::function<void()> thread_init)
+    : workers_(),
+      thread_init_(std::move(thread_init)),
+      jobs_(),
+      lock_(),
+      jobs_cv_(),
+      stop_(false) {
+    workers_.reserve(num_threads);
+    for (size_t i = 0; i < num_threads; ++i) {
+        workers_.emplace_back(&lookup_pool::worker_loop, this);
+    }
+}
+
+lookup_pool::~lookup_pool() {
+    {
+        std::lock_guard<std::mutex> guard(lock_);
+        stop_ = true;
+    }
+    jobs_cv_.notify_all();
+
+    for (auto& worker : workers_) {
+        worker.join();
+    }
+}
+
+void lookup_pool::run(job& j) {
+    for (size_t i = j.next_++; i < j.count_; i = j.next_++) {
+        j.fn_(i);
+
+        if (++j.done_ == j.count_) {
+            std::lock_guard<std::mutex> guard(j.lock_);
+            j.done_cv_.notify_all();
+        }
+    }
+}
+
+void lookup_pool::worker_loop() {
+    if (thread_init_) {
+        thread_init_();
+    }
+
+    std::unique_lock<std::mutex> guard(lock_);
+    while (true) {
+        jobs_cv_.wait(guard, [this] { return stop_ || !jobs_.empty(); });
+        if (stop_) {
+            return;
+        }
+
+        std::shared_ptr<job> j = jobs_.front();
+        guard.unlock();
+        run(*j);
+        guard.lock();
+
+        // Every call has been claimed, so nobody else needs to see it.
+        if (!jobs_.empty() && jobs_.front() == j) {
+            jobs_.pop_front();
+        }
+    }
+}
+
+void lookup_pool::parallel_for(size_t count,
+                               const std::function<void(size_t)>& fn) {
+    if (count == 0) {
+        return;
+    }
+
+    if (count == 1 || workers_.empty()) {
+        for (size_t i = 0; i < count; ++i) {
+            fn(i);
+        }
+        return;
+    }
+
+    auto j = std::make_shared<job>(count, fn);
+    {
+        std::lock_guard<std::mutex> guard(lock_);
+        jobs_.push_back(j);
+    }
+    if (count - 1 >= workers_.size()) {
+        jobs_cv_.notify_all();
+    } else {
+        for (size_t i = 0; i < count - 1; ++i) {
+            jobs_cv_.notify_one();
+        }
+    }
+
+    run(*j);
+
+    {
+        std::unique_lock<std::mutex> guard(j->lock_);
+        j->done_cv_.wait(guard, [&] { return j->done_ == count; });
+    }
+
+    std::lock_guard<std::mutex> guard(lock_);
+    auto pos = std::find(jobs_.begin(), jobs_.end(), j);
+    if (pos != jobs_.end()) {
+        jobs_.erase(pos);
+    }
+}
+
+}  // namespace replicated_splinterdb
@@ -0,0 +1,77 @@
+#ifndef REPLICATED_SPLINTERDB_LOOKUP_POOL_H
+#define REPLICATED_SPLINTERDB_LOOKUP_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace replicated_splinterdb {
+
+/**
+ * Fixed set of threads for fanning out SplinterDB lookups.
+ *
+ * Every worker runs `thread_init` once when it starts, which is where it
+ * registers with SplinterDB. The calling thread always takes part in the
+ * work, so a request is never stuck behind a busy pool.
+ */
+class lookup_pool {
+  public:
+    lookup_pool(size_t num_threads, std::function<void()> thread_init);
+
+    ~lookup_pool();
+
+    lookup_pool(const lookup_pool&) = delete;
+
+    lookup_pool& operator=(const lookup_pool&) = delete;
+
+    /**
+     * Call `fn(i)` for every `i` in [0, count), spread over the pool and
+     * the calling thread. Returns once every call has returned.
+     *
+     * @param count Number of calls.
+     * @param fn Function to call. Must be safe to call concurrently.
+     */
+    void parallel_for(size_t count, const std::function<void(size_t)>& fn);
+
+  private:
+    struct job {
+        job(size_t count, const std::function<void(size_t)>& fn)
+            : count_(count), fn_(fn), next_(0), done_(0) {}
+
+        const size_t count_;
+        const std::function<void(size_t)>& fn_;
+        std::atomic<size_t> next_;
+        std::atomic<size_t> done_;
+        std::mutex lock_;
+        std::condition_variable done_cv_;
+    };
+
+    // Run calls of `j` until there are none left to claim.
+    static void run(job& j);
+
+    void worker_loop();
+
+    std::vector<std::thread> workers_;
+
+    std::function<void()> thread_init_;
+
+    // Jobs that may still have unclaimed calls, oldest first.
+    std::deque<std::shared_ptr<job>> jobs_;
+
+    // Mutex for `jobs_` and `stop_`.
+    std::mutex lock_;
+
+    // Signalled when a job is queued or the pool is stopping.
+    std::condition_variable jobs_cv_;
+
+    bool stop_;
+};
+
+}  // namespace replicated_splinterdb
+
+#endif  // REPLICATED_SPLINTERDB_LOOKUP_POOL_H
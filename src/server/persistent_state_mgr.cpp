@@ -0,0 +1,197 @@
+#include "persistent_state_mgr.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <stdexcept>
+
+namespace replicated_splinterdb {
+
+using nuraft::buffer;
+using nuraft::cluster_config;
+using nuraft::cs_new;
+using nuraft::ptr;
+using nuraft::srv_config;
+using nuraft::srv_state;
+
+static const char* const CONFIG_FILE = "config";
+static const char* const STATE_FILE = "state";
+
+// Length and CRC32 of the payload, ahead of it in every file.
+static constexpr size_t HEADER_SIZE = 2 * sizeof(uint32_t);
+
+static void throw_errno(const std::string& what) {
+    throw std::runtime_error(what + ": " + std::strerror(errno));
+}
+
+static uint32_t checksum(const void* data, size_t len) {
+    return static_cast<uint32_t>(
+        ::crc32(0L, static_cast<const Bytef*>(data), static_cast<uInt>(len)));
+}
+
+static void write_fully(int fd, const void* data, size_t len) {
+    auto src = static_cast<const char*>(data);
+    while (len > 0) {
+        ssize_t n = ::write(fd, src, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            throw_errno("failed to write Raft state");
+        }
+
+        src += n;
+        len -= static_cast<size_t>(n);
+    }
+}
+
+static void sync_directory(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_DIRECTORY);
+    if (fd < 0) {
+        throw_errno("failed to open " + path);
+    }
+
+    int rc = ::fsync(fd);
+    ::close(fd);
+    if (rc != 0) {
+        throw_errno("failed to sync " + path);
+    }
+}
+
+persistent_state_mgr::persistent_state_mgr(const std::string& directory,
+                                           int32_t server_id,
+                                           const std::string& raft_endpoint,
+                                           const std::string& client_endpoint,
+                                           ptr<nuraft::log_store> log_store)
+    : directory_(directory),
+      server_id_(server_id),
+      log_store_(std::move(log_store)),
+      saved_config_(nullptr),
+      saved_state_(nullptr),
+      lock_(),
+      recovered_(false) {
+    std::filesystem::create_directories(directory_);
+
+    ptr<buffer> config = read_file(CONFIG_FILE);
+    if (config != nullptr) {
+        saved_config_ = cluster_config::deserialize(*config);
+    } else {
+        // Initial cluster config: contains only one server (myself).
+        saved_config_ = cs_new<cluster_config>();
+        saved_config_->get_servers().push_back(cs_new<srv_config>(
+            server_id, 0, raft_endpoint, client_endpoint, false));
+    }
+
+    ptr<buffer> state = read_file(STATE_FILE);
+    if (state != nullptr) {
+        saved_state_ = srv_state::deserialize(*state);
+    }
+
+    recovered_ = config != nullptr;
+}
+
+ptr<cluster_config> persistent_state_mgr::load_config() {
+    std::lock_guard<std::mutex> guard(lock_);
+    return saved_config_;
+}
+
+void persistent_state_mgr::save_config(const cluster_config& config) {
+    ptr<buffer> buf = config.serialize();
+
+    std::lock_guard<std::mutex> guard(lock_);
+    write_file(CONFIG_FILE, *buf);
+    saved_config_ = cluster_config::deserialize(*buf);
+}
+
+void persistent_state_mgr::save_state(const srv_state& state) {
+    ptr<buffer> buf = state.serialize();
+
+    std::lock_guard<std::mutex> guard(lock_);
+    write_file(STATE_FILE, *buf);
+    saved_state_ = srv_state::deserialize(*buf);
+}
+
+ptr<srv_state> persistent_state_mgr::read_state() {
+    std::lock_guard<std::mutex> guard(lock_);
+    return saved_state_;
+}
+
+ptr<nuraft::log_store> persistent_state_mgr::load_log_store() {
+    return log_store_;
+}
+
+nuraft::int32 persistent_state_mgr::server_id() { return server_id_; }
+
+void persistent_state_mgr::system_exit(const int exit_code) {
+    std::cerr << "ERROR: Raft requested exit with code " << exit_code
+              << std::endl;
+}
+
+void persistent_state_mgr::write_file(const std::string& name, buffer& data) {
+    std::string path = directory_ + "/" + name;
+    std::string tmp_path = path + ".tmp";
+
+    uint32_t header[2] = {static_cast<uint32_t>(data.size()),
+                          checksum(data.data_begin(), data.size())};
+
+    int fd = ::open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        throw_errno("failed to create " + tmp_path);
+    }
+
+    try {
+        write_fully(fd, header, HEADER_SIZE);
+        write_fully(fd, data.data_begin(), data.size());
+        if (::fsync(fd) != 0) {
+            throw_errno("failed to sync " + tmp_path);
+        }
+    } catch (...) {
+        ::close(fd);
+        throw;
+    }
+    ::close(fd);
+
+    if (::rename(tmp_path.c_str(), path.c_str()) != 0) {
+        throw_errno("failed to replace " + path);
+    }
+
+    // Make the rename itself durable.
+    sync_directory(directory_);
+}
+
+ptr<buffer> persistent_state_mgr::read_file(const std::string& name) const {
+    std::string path = directory_ + "/" + name;
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        if (errno == ENOENT) {
+            return nullptr;
+        }
+        throw_errno("failed to open " + path);
+    }
+
+    uint32_t header[2];
+    ptr<buffer> data = nullptr;
+    if (::read(fd, header, HEADER_SIZE) == static_cast<ssize_t>(HEADER_SIZE)) {
+        data = buffer::alloc(header[0]);
+        ssize_t n = ::read(fd, data->data_begin(), header[0]);
+        if (n != static_cast<ssize_t>(header[0]) ||
+            checksum(data->data_begin(), header[0]) != header[1]) {
+            data = nullptr;
+        }
+    }
+    ::close(fd);
+
+    // Files are only ever replaced by a rename, so a bad one means the disk
+    // lost data rather than a write was interrupted. Going on without it
+    // could mean voting twice in a term.
+    if (data == nullptr) {
+        throw std::runtime_error("corrupt Raft state file " + path);
+    }
+    return data;
+}
+
+}  // namespace replicated_splinterdb
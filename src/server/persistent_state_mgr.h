@@ -0,0 +1,74 @@
+#ifndef REPLICATED_SPLINTERDB_PERSISTENT_STATE_MGR_H
+#define REPLICATED_SPLINTERDB_PERSISTENT_STATE_MGR_H
+
+#include <mutex>
+#include <string>
+
+#include "libnuraft/nuraft.hxx"
+
+namespace replicated_splinterdb {
+
+/**
+ * Raft state manager that keeps the server's term, vote and cluster
+ * configuration on disk, so a restarted replica rejoins its group on its
+ * own instead of being added again.
+ *
+ * The state and the configuration are each kept in a file of their own,
+ * holding the serialized object behind its length and CRC32. A file is
+ * replaced by writing and syncing a temporary file, then renaming it over
+ * the old one and syncing the directory, so a crash leaves either the old
+ * or the new contents.
+ */
+class persistent_state_mgr : public nuraft::state_mgr {
+  public:
+    persistent_state_mgr(const std::string& directory, int32_t server_id,
+                         const std::string& raft_endpoint,
+                         const std::string& client_endpoint,
+                         nuraft::ptr<nuraft::log_store> log_store);
+
+    persistent_state_mgr(const persistent_state_mgr&) = delete;
+
+    persistent_state_mgr& operator=(const persistent_state_mgr&) = delete;
+
+    nuraft::ptr<nuraft::cluster_config> load_config() override;
+
+    void save_config(const nuraft::cluster_config& config) override;
+
+    void save_state(const nuraft::srv_state& state) override;
+
+    nuraft::ptr<nuraft::srv_state> read_state() override;
+
+    nuraft::ptr<nuraft::log_store> load_log_store() override;
+
+    nuraft::int32 server_id() override;
+
+    void system_exit(const int exit_code) override;
+
+    // Whether the state of an earlier run was found on disk.
+    bool has_saved_state() const { return recovered_; }
+
+  private:
+    // Atomically replace the file `name` with `data`.
+    void write_file(const std::string& name, nuraft::buffer& data);
+
+    // The contents of the file `name`, or null if it does not exist. Throws
+    // if it fails its checksum.
+    nuraft::ptr<nuraft::buffer> read_file(const std::string& name) const;
+
+    const std::string directory_;
+    const int32_t server_id_;
+    nuraft::ptr<nuraft::log_store> log_store_;
+
+    // Copies of what is on disk, returned by the loaders.
+    nuraft::ptr<nuraft::cluster_config> saved_config_;
+    nuraft::ptr<nuraft::srv_state> saved_state_;
+
+    // Mutex for the saved copies and the files.
+    std::mutex lock_;
+
+    bool recovered_;
+};
+
+}  // namespace replicated_splinterdb
+
+#endif  // REPLICATED_SPLINTERDB_PERSISTENT_STATE_MGR_H
@@ -1,11 +1,20 @@
 #include "replicated-splinterdb/server/replica.h"
 
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
 #include <filesystem>
+#include <functional>
+#include <future>
 #include <iostream>
+#include <thread>
+#include <vector>
 
 #include "in_memory_state_mgr.hxx"
 #include "logger.h"
+#include "persistent_state_mgr.h"
 #include "replicated-splinterdb/server/splinterdb_wrapper.h"
+#include "segmented_log_store.h"
 #include "splinterdb_state_machine.h"
 
 #define S_ERR _s_err(std::dynamic_pointer_cast<SimpleLogger>(logger_))
@@ -18,19 +27,35 @@ using nuraft::asio_service;
 using nuraft::buffer;
 using nuraft::cmd_result_code;
 using nuraft::cs_new;
+using nuraft::inmem_log_store;
 using nuraft::inmem_state_mgr;
+using nuraft::log_store;
 using nuraft::ptr;
 using nuraft::raft_params;
 using nuraft::srv_config;
 
+static ptr<log_store> create_log_store(const replica_config& config) {
+    switch (config.log_store_type_) {
+        case log_store_type::in_memory:
+            return cs_new<inmem_log_store>();
+        case log_store_type::segmented:
+            return cs_new<segmented_log_store>(
+                config.log_store_dir_.value_or(
+                    "raft-log-" + std::to_string(config.server_id_)),
+                config.log_segment_size_, config.log_fsync_policy_);
+        default:
+            throw std::invalid_argument("unknown log store type");
+    }
+}
+
 void replica::default_raft_params_init(raft_params& params) {
     // heartbeat: 100 ms, election timeout: 200 - 400 ms.
     params.heart_beat_interval_ = 100;
     params.election_timeout_lower_bound_ = 300;
     params.election_timeout_upper_bound_ = 500;
 
-    // Up to 5 logs will be preserved ahead the last snapshot.
-    params.reserved_log_items_ = 1000000;
+    // Up to 100000 logs will be preserved ahead the last snapshot.
+    params.reserved_log_items_ = 100000;
     // Client timeout: 3000 ms.
     params.client_req_timeout_ = 3000;
     // According to this method, `append_log` function
@@ -38,6 +63,11 @@ void replica::default_raft_params_init(raft_params& params) {
     params.return_method_ = raft_params::blocking;
 
     params.auto_forwarding_ = true;
+
+    // The leader steps down when it has not heard from a quorum for this
+    // long, well before a follower would start an election. Lease reads do
+    // not rely on this; they check the acknowledgements themselves.
+    params.leadership_expiry_ = params.election_timeout_lower_bound_ / 2;
 }
 
 replica::replica(const replica_config& config)
@@ -50,8 +80,13 @@ replica::replica(const replica_config& config)
       logger_(nullptr),
       spl_log_file_(nullptr),
       sm_(nullptr),
+      log_store_(nullptr),
       smgr_(nullptr),
-      raft_instance_(nullptr) {
+      raft_instance_(nullptr),
+      recovered_(false),
+      client_timeout_ms_(0),
+      lease_duration_(0),
+      confirm_poll_interval_(0) {
     if (!config_.server_id_) {
         throw std::invalid_argument("server_id must be set");
     }
@@ -78,11 +113,44 @@ replica::replica(const replica_config& config)
     spl_log_file_ = fopen(spl_log_file_name.c_str(), "w");
     platform_set_log_streams(spl_log_file_, spl_log_file_);
 
-    // Initialize SplinterDB state machine and state manager
-    sm_ = cs_new<splinterdb_state_machine>(config_.splinterdb_cfg_,
-                                           config_.snapshot_frequency_ <= 0);
-    smgr_ =
-        cs_new<inmem_state_mgr>(server_id_, raft_endpoint_, client_endpoint_);
+    // Initialize the state manager and SplinterDB state machine. The Raft
+    // state is only worth keeping if the log survives a restart too.
+    log_store_ = create_log_store(config_);
+    if (config_.log_store_type_ == log_store_type::in_memory) {
+        smgr_ = cs_new<inmem_state_mgr>(server_id_, raft_endpoint_,
+                                        client_endpoint_, log_store_);
+    } else {
+        auto smgr = cs_new<persistent_state_mgr>(
+            config_.state_dir_.value_or("raft-state-" +
+                                        std::to_string(server_id_)),
+            server_id_, raft_endpoint_, client_endpoint_, log_store_);
+        recovered_ = smgr->has_saved_state();
+        smgr_ = smgr;
+
+        // Logs without the term and vote they were written under could be
+        // replayed into a group that has moved on since.
+        if (!recovered_ && log_store_->next_slot() > 1) {
+            throw std::runtime_error(
+                "found Raft logs but no Raft state; remove the log directory "
+                "to start over");
+        }
+    }
+
+    if (recovered_ &&
+        !std::filesystem::exists(config_.splinterdb_cfg_.filename)) {
+        throw std::runtime_error(
+            std::string("found Raft state but no SplinterDB file ") +
+            config_.splinterdb_cfg_.filename +
+            "; remove the state directory to start over");
+    }
+
+    sm_ = cs_new<splinterdb_state_machine>(
+        config_.splinterdb_cfg_, recovered_, config_.snapshot_frequency_ <= 0,
+        config_.snapshot_obj_size_);
+    if (recovered_) {
+        std::cout << "Recovered Raft state and SplinterDB file of server "
+                  << server_id_ << std::endl;
+    }
 
     initialize();
 }
@@ -93,8 +161,28 @@ void replica::initialize() {
     raft_params params;
     default_raft_params_init(params);
     params.snapshot_distance_ = std::max(0, config_.snapshot_frequency_);
+    params.reserved_log_items_ = config_.reserved_log_items_;
 
     params.return_method_ = config_.get_return_method();
+    client_timeout_ms_ = static_cast<uint64_t>(params.client_req_timeout_);
+
+    // A follower that acknowledged the leader does not start an election
+    // for at least the election timeout after it received that heartbeat.
+    // The lease ends halfway there, leaving the rest for the time the
+    // acknowledgement spent on the way back and for clock drift.
+    lease_duration_ =
+        std::chrono::milliseconds(params.election_timeout_lower_bound_ / 2);
+    confirm_poll_interval_ =
+        std::chrono::milliseconds(
+            std::max(1, params.heart_beat_interval_ / 10));
+
+    // The group commit flusher tells Raft when appended logs are durable, so
+    // the leader can replicate while its own append is still being synced.
+    auto segmented = std::dynamic_pointer_cast<segmented_log_store>(log_store_);
+    bool group_commit =
+        segmented != nullptr &&
+        config_.log_fsync_policy_ == log_fsync_policy::group_commit;
+    params.parallel_log_appending_ = group_commit;
 
     asio_service::options asio_opt;
     asio_opt.thread_pool_size_ = config_.asio_thread_pool_size_;
@@ -112,6 +200,10 @@ void replica::initialize() {
         exit(-1);
     }
 
+    if (group_commit) {
+        segmented->set_raft_server(raft_instance_.get());
+    }
+
     // Wait until Raft server is ready (up to 5 seconds).
     std::cout << "Initializing Raft instance ";
     for (size_t ii = 0; ii < config_.initialization_retries_; ++ii) {
@@ -131,6 +223,11 @@ void replica::initialize() {
 }
 
 void replica::shutdown(size_t time_limit_sec) {
+    auto segmented = std::dynamic_pointer_cast<segmented_log_store>(log_store_);
+    if (segmented != nullptr) {
+        segmented->set_raft_server(nullptr);
+    }
+
     launcher_.shutdown(time_limit_sec);
 }
 
@@ -138,6 +235,69 @@ void replica::register_thread() {
     splinterdb_register_thread(sm_->get_splinterdb_handle());
 }
 
+std::chrono::steady_clock::time_point replica::quorum_ack_time() const {
+    auto now = std::chrono::steady_clock::now();
+    std::vector<std::chrono::steady_clock::time_point> acks;
+    for (const auto& peer : raft_instance_->get_peer_info_all()) {
+        auto since_ack = std::chrono::microseconds(peer.last_succ_resp_us_);
+        acks.push_back(now - since_ack);
+    }
+
+    // This replica is part of the quorum, so only the other members of a
+    // majority need to have answered. Peers are only listed on the leader.
+    std::vector<ptr<srv_config>> members;
+    raft_instance_->get_srv_config_all(members);
+    size_t needed = members.size() / 2;
+    if (acks.size() < needed) {
+        return {};
+    }
+    if (needed == 0) {
+        return now;
+    }
+    auto nth = acks.begin() + static_cast<std::ptrdiff_t>(needed - 1);
+    std::nth_element(acks.begin(), nth, acks.end(), std::greater<>());
+    return acks[needed - 1];
+}
+
+bool replica::has_leader_lease() const {
+    if (!raft_instance_->is_leader()) {
+        return false;
+    }
+    // A new leader first appends a log of its own term, so once the commit
+    // index reaches a log of this term it covers everything committed before.
+    if (log_store_->term_at(raft_instance_->get_committed_log_idx()) !=
+        raft_instance_->get_term()) {
+        return false;
+    }
+    return std::chrono::steady_clock::now() - quorum_ack_time() <
+           lease_duration_;
+}
+
+bool replica::confirm_leadership(uint64_t timeout_ms) {
+    // An acknowledgement that arrives after this point answers a heartbeat
+    // sent at most one message delay earlier, far less than it takes to
+    // elect and commit under another leader. Heartbeats go out on their own
+    // schedule, so this waits up to a heartbeat interval and adds no log.
+    auto since = std::chrono::steady_clock::now();
+    auto deadline = since + std::chrono::milliseconds(timeout_ms);
+    while (raft_instance_->is_leader()) {
+        if (quorum_ack_time() > since) {
+            return true;
+        }
+        if (std::chrono::steady_clock::now() >= deadline) {
+            return false;
+        }
+        std::this_thread::sleep_for(confirm_poll_interval_);
+    }
+    return false;
+}
+
+bool replica::wait_for_commit(uint64_t log_idx, uint64_t timeout_ms) {
+    return sm_->wait_for_commit(
+        log_idx,
+        std::chrono::milliseconds(static_cast<int64_t>(timeout_ms)));
+}
+
 void replica::dump_cache(const std::string& directory) {
     splinterdb_print_cache(sm_->get_splinterdb_handle(), directory.c_str());
 }
@@ -147,25 +307,64 @@ void replica::clear_cache() {
 }
 
 std::pair<std::unique_ptr<std::string>, int32_t> replica::read(slice&& key) {
+    auto value = std::make_unique<std::string>();
+    int32_t retcode = read(std::forward<slice>(key), *value);
+    if (retcode != 0) {
+        return {nullptr, retcode};
+    }
+
+    return {std::move(value), retcode};
+}
+
+int32_t replica::read(slice key, std::string& value) {
+    if (is_reserved_key({static_cast<const char*>(key.data),
+                         static_cast<size_t>(key.length)})) {
+        // What SplinterDB returns for a key that is not found.
+        return EINVAL;
+    }
+
     splinterdb_lookup_result result;
     splinterdb_lookup_result_init(sm_->get_splinterdb_handle(), &result, 0,
                                   NULL);
 
-    int retcode = splinterdb_lookup(sm_->get_splinterdb_handle(),
-                                    std::forward<slice>(key), &result);
-    if (retcode != 0) {
-        return {nullptr, retcode};
+    int retcode = splinterdb_lookup(sm_->get_splinterdb_handle(), key, &result);
+    if (retcode == 0) {
+        slice found;
+        retcode = splinterdb_lookup_result_value(&result, &found);
+        if (retcode == 0) {
+            value.assign(static_cast<const char*>(found.data),
+                         static_cast<size_t>(found.length));
+        }
     }
 
-    slice value;
-    retcode = splinterdb_lookup_result_value(&result, &value);
+    splinterdb_lookup_result_deinit(&result);
+    return retcode;
+}
+
+int32_t replica::scan(slice start_key,
+                      const std::function<bool(slice, slice)>& visit) {
+    splinterdb_iterator* it = nullptr;
+    int retcode = splinterdb_iterator_init(sm_->get_splinterdb_handle(), &it,
+                                           start_key);
     if (retcode != 0) {
-        return {nullptr, retcode};
+        return retcode;
     }
 
-    return {std::make_unique<std::string>(static_cast<const char*>(value.data),
-                                          static_cast<size_t>(value.length)),
-            retcode};
+    for (; splinterdb_iterator_valid(it); splinterdb_iterator_next(it)) {
+        slice key, value;
+        splinterdb_iterator_get_current(it, &key, &value);
+        if (is_reserved_key({static_cast<const char*>(key.data),
+                             static_cast<size_t>(key.length)})) {
+            continue;
+        }
+        if (!visit(key, value)) {
+            break;
+        }
+    }
+
+    retcode = splinterdb_iterator_status(it);
+    splinterdb_iterator_deinit(it);
+    return retcode;
 }
 
 std::pair<cmd_result_code, std::string> replica::add_server(
@@ -189,17 +388,55 @@ std::pair<cmd_result_code, std::string> replica::add_server(
 }
 
 ptr<replica::raft_result> replica::append_log(const splinterdb_operation& op) {
-    ptr<buffer> new_log(op.serialize());
+    ptr<buffer> new_log(op.serialize(config_.log_compression_threshold_));
     ptr<raft_result> ret = raft_instance_->append_entries({new_log});
 
-    if (config_.get_return_method() == raft_params::blocking) {
+    if (config_.get_return_method() == raft_params::blocking ||
+        !ret->get_accepted()) {
         // Blocking mode:
         //   `append_entries` returns after getting a consensus,
         //   so that `ret` already has the result from state machine.
         return ret;
-    } else /* if (config_.return_method_ == raft_params::async_handler) */ {
-        throw std::runtime_error("async handler not implemented");
     }
+
+    // Async mode: wait for the state machine to commit the log. NuRaft may
+    // never call back, e.g. if it loses leadership with the log still
+    // uncommitted, so give up after the client timeout.
+    auto committed = std::make_shared<std::promise<void>>();
+    std::future<void> done = committed->get_future();
+    ret->when_ready([committed](ptr<buffer>&, ptr<std::exception>&) {
+        committed->set_value();
+    });
+    if (done.wait_for(std::chrono::milliseconds(client_timeout_ms_)) !=
+        std::future_status::ready) {
+        ptr<buffer> none = nullptr;
+        return cs_new<raft_result>(none, true, cmd_result_code::TIMEOUT);
+    }
+    return ret;
+}
+
+void replica::append_log(const splinterdb_operation& op,
+                         handle_commit_result handle_result) {
+    ptr<Timer> timer = cs_new<Timer>();
+    ptr<buffer> new_log(op.serialize(config_.log_compression_threshold_));
+    ptr<raft_result> ret = raft_instance_->append_entries({new_log});
+
+    if (config_.get_return_method() == raft_params::blocking ||
+        !ret->get_accepted()) {
+        // The result is already final.
+        ptr<std::exception> err = nullptr;
+        handle_result(timer, *ret, err);
+        return;
+    }
+
+    // Raft keeps `ret` alive until it sets the result, which is what calls
+    // the handler. Holding a `ptr` in the handler would be a cycle.
+    raft_result* result = ret.get();
+    ret->when_ready(
+        [timer, result, handle_result = std::move(handle_result)](
+            ptr<buffer>&, ptr<std::exception>& err) {
+            handle_result(timer, *result, err);
+        });
 }
 
 }  // namespace replicated_splinterdb
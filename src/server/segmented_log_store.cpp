@@ -0,0 +1,814 @@
+#include "segmented_log_store.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+#include "libnuraft/nuraft.hxx"
+
+namespace replicated_splinterdb {
+
+using nuraft::buffer;
+using nuraft::cs_new;
+using nuraft::int32;
+using nuraft::int64;
+using nuraft::log_entry;
+using nuraft::ptr;
+using nuraft::ulong;
+
+static void throw_errno(const std::string& what) {
+    throw std::runtime_error(what + ": " + std::strerror(errno));
+}
+
+static void pwrite_fully(int fd, const void* data, size_t len,
+                         uint64_t offset) {
+    auto src = static_cast<const char*>(data);
+    while (len > 0) {
+        ssize_t n = ::pwrite(fd, src, len, static_cast<off_t>(offset));
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            throw_errno("failed to write log segment");
+        }
+
+        src += n;
+        len -= static_cast<size_t>(n);
+        offset += static_cast<uint64_t>(n);
+    }
+}
+
+static bool pread_fully(int fd, void* data, size_t len, uint64_t offset) {
+    auto dst = static_cast<char*>(data);
+    while (len > 0) {
+        ssize_t n = ::pread(fd, dst, len, static_cast<off_t>(offset));
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            throw_errno("failed to read log segment");
+        } else if (n == 0) {
+            return false;
+        }
+
+        dst += n;
+        len -= static_cast<size_t>(n);
+        offset += static_cast<uint64_t>(n);
+    }
+
+    return true;
+}
+
+static void sync_fd(int fd) {
+    if (::fdatasync(fd) != 0) {
+        throw_errno("failed to sync log segment");
+    }
+}
+
+static void truncate_fd(int fd, uint64_t size) {
+    if (::ftruncate(fd, static_cast<off_t>(size)) != 0) {
+        throw_errno("failed to truncate log segment");
+    }
+}
+
+static uint32_t checksum(const void* data, size_t len) {
+    return static_cast<uint32_t>(
+        ::crc32(0L, static_cast<const Bytef*>(data), static_cast<uInt>(len)));
+}
+
+// Holds the index of the first log, so that it survives a restart even if
+// the log was compacted in the middle of a segment.
+static const char* const START_FILE = "start";
+
+static ptr<log_entry> dummy_entry() {
+    return cs_new<log_entry>(0, buffer::alloc(nuraft::sz_ulong));
+}
+
+segmented_log_store::segmented_log_store(const std::string& directory,
+                                         size_t segment_size,
+                                         log_fsync_policy fsync_policy)
+    : directory_(directory),
+      segment_size_(segment_size),
+      fsync_policy_(fsync_policy),
+      segments_(),
+      lock_(),
+      start_idx_(1),
+      last_durable_idx_(0),
+      truncate_epoch_(0),
+      raft_server_(nullptr),
+      completion_pending_(false),
+      flusher_(),
+      flush_cv_(),
+      durable_cv_(),
+      stop_flusher_(false) {
+    std::filesystem::create_directories(directory_);
+
+    std::vector<ulong> bases;
+    for (const auto& f : std::filesystem::directory_iterator(directory_)) {
+        if (f.path().extension() == ".seg") {
+            bases.push_back(std::stoull(f.path().stem().string()));
+        }
+    }
+    std::sort(bases.begin(), bases.end());
+
+    // Segments that end before the saved start were compacted away, or
+    // replaced by a reset, before the process stopped.
+    ulong saved_start = load_start();
+    auto first = std::upper_bound(bases.begin(), bases.end(), saved_start);
+    if (first != bases.begin()) {
+        --first;
+    }
+    for (auto it = bases.begin(); it != first; ++it) {
+        std::filesystem::remove(segment_path(*it, "seg"));
+        std::filesystem::remove(segment_path(*it, "idx"));
+    }
+    bases.erase(bases.begin(), first);
+
+    for (size_t i = 0; i < bases.size(); ++i) {
+        bool active = i + 1 == bases.size();
+
+        // A segment that does not pick up where the previous one ended
+        // follows a torn write; everything from here on is unusable.
+        if (!segments_.empty() &&
+            segments_.rbegin()->second->next_idx() != bases[i]) {
+            for (size_t j = i; j < bases.size(); ++j) {
+                std::filesystem::remove(segment_path(bases[j], "seg"));
+                std::filesystem::remove(segment_path(bases[j], "idx"));
+            }
+            break;
+        }
+
+        open_segment(bases[i], active);
+    }
+
+    // A reset that stopped after saving its start but before creating its
+    // segment leaves the start past the end of the log. The log restarts
+    // empty there, as the reset intended.
+    if (!segments_.empty() &&
+        segments_.rbegin()->second->next_idx() < saved_start) {
+        while (!segments_.empty()) {
+            remove_segment(segments_.begin()->first);
+        }
+    }
+
+    if (segments_.empty()) {
+        create_segment(std::max<ulong>(saved_start, 1));
+    }
+
+    start_idx_ = std::max(segments_.begin()->first, saved_start);
+    last_durable_idx_ = next_slot_locked() - 1;
+
+    if (fsync_policy_ == log_fsync_policy::group_commit) {
+        flusher_ = std::thread(&segmented_log_store::flush_loop, this);
+    }
+}
+
+segmented_log_store::~segmented_log_store() { close(); }
+
+std::string segmented_log_store::segment_path(ulong base_idx,
+                                              const char* ext) const {
+    std::ostringstream ss;
+    ss << directory_ << "/" << std::setw(20) << std::setfill('0') << base_idx
+       << "." << ext;
+    return ss.str();
+}
+
+void segmented_log_store::open_segment(ulong base_idx, bool active) {
+    auto seg = std::make_unique<segment>();
+    seg->base_idx_ = base_idx;
+    seg->fd_ = ::open(segment_path(base_idx, "seg").c_str(), O_RDWR);
+    if (seg->fd_ < 0) {
+        throw_errno("failed to open log segment");
+    }
+
+    seg->idx_fd_ =
+        ::open(segment_path(base_idx, "idx").c_str(), O_RDWR | O_CREAT, 0644);
+    if (seg->idx_fd_ < 0) {
+        throw_errno("failed to open log segment index");
+    }
+
+    struct stat st {};
+    if (::fstat(seg->fd_, &st) != 0) {
+        throw_errno("failed to stat log segment");
+    }
+    seg->size_ = static_cast<uint64_t>(st.st_size);
+
+    // The index of the active segment is only written when it is sealed, so
+    // the whole segment has to be scanned. Sealed segments trust their index
+    // and only re-verify the last indexed record and anything after it.
+    size_t first_unindexed = 0;
+    if (!active) {
+        if (::fstat(seg->idx_fd_, &st) != 0) {
+            throw_errno("failed to stat log segment index");
+        }
+
+        size_t count = static_cast<size_t>(st.st_size) / sizeof(index_entry);
+        std::vector<index_entry> entries(count);
+        if (count > 0 && !pread_fully(seg->idx_fd_, entries.data(),
+                                      count * sizeof(index_entry), 0)) {
+            entries.clear();
+        }
+
+        uint64_t prev_offset = 0;
+        for (const auto& ie : entries) {
+            if (ie.offset_ >= seg->size_ ||
+                (!seg->offsets_.empty() && ie.offset_ <= prev_offset)) {
+                break;
+            }
+
+            seg->offsets_.push_back(ie.offset_);
+            seg->terms_.push_back(ie.term_);
+            prev_offset = ie.offset_;
+        }
+
+        if (!seg->offsets_.empty()) {
+            first_unindexed = seg->offsets_.size() - 1;
+        }
+    }
+
+    scan_segment(*seg, first_unindexed);
+    segments_[base_idx] = std::move(seg);
+}
+
+void segmented_log_store::scan_segment(segment& seg, size_t first_unindexed) {
+    uint64_t offset = 0;
+    if (first_unindexed < seg.offsets_.size()) {
+        offset = seg.offsets_[first_unindexed];
+        seg.offsets_.resize(first_unindexed);
+        seg.terms_.resize(first_unindexed);
+    }
+
+    record_header hdr{};
+    while (offset + sizeof(hdr) <= seg.size_) {
+        if (!pread_fully(seg.fd_, &hdr, sizeof(hdr), offset) ||
+            offset + sizeof(hdr) + hdr.length_ > seg.size_) {
+            break;
+        }
+
+        ptr<buffer> payload = buffer::alloc(hdr.length_);
+        if (!pread_fully(seg.fd_, payload->data_begin(), hdr.length_,
+                         offset + sizeof(hdr)) ||
+            checksum(payload->data_begin(), hdr.length_) != hdr.crc_) {
+            break;
+        }
+
+        ptr<log_entry> le = log_entry::deserialize(*payload);
+        seg.offsets_.push_back(offset);
+        seg.terms_.push_back(le->get_term());
+        offset += sizeof(hdr) + hdr.length_;
+    }
+
+    // Drop a torn or corrupted tail.
+    if (offset != seg.size_) {
+        truncate_fd(seg.fd_, offset);
+        seg.size_ = offset;
+    }
+}
+
+void segmented_log_store::create_segment(ulong base_idx) {
+    int fd = ::open(segment_path(base_idx, "seg").c_str(),
+                    O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        throw_errno("failed to create log segment");
+    }
+    ::close(fd);
+
+    std::filesystem::remove(segment_path(base_idx, "idx"));
+    open_segment(base_idx, true);
+
+    if (fsync_policy_ != log_fsync_policy::never) {
+        sync_directory();
+    }
+}
+
+void segmented_log_store::remove_segment(ulong base_idx) {
+    auto it = segments_.find(base_idx);
+    if (it == segments_.end()) return;
+
+    ::close(it->second->fd_);
+    ::close(it->second->idx_fd_);
+    segments_.erase(it);
+
+    std::filesystem::remove(segment_path(base_idx, "seg"));
+    std::filesystem::remove(segment_path(base_idx, "idx"));
+}
+
+void segmented_log_store::seal_segment(segment& seg) {
+    std::vector<index_entry> entries(seg.offsets_.size());
+    for (size_t i = 0; i < entries.size(); ++i) {
+        entries[i] = {seg.offsets_[i], seg.terms_[i]};
+    }
+
+    truncate_fd(seg.idx_fd_, 0);
+    pwrite_fully(seg.idx_fd_, entries.data(),
+                 entries.size() * sizeof(index_entry), 0);
+
+    if (fsync_policy_ != log_fsync_policy::never) {
+        sync_fd(seg.fd_);
+        sync_fd(seg.idx_fd_);
+    }
+}
+
+void segmented_log_store::sync_directory() const {
+    int fd = ::open(directory_.c_str(), O_RDONLY | O_DIRECTORY);
+    if (fd < 0) {
+        throw_errno("failed to open log directory");
+    }
+
+    int rc = ::fsync(fd);
+    ::close(fd);
+    if (rc != 0) {
+        throw_errno("failed to sync log directory");
+    }
+}
+
+ulong segmented_log_store::load_start() const {
+    std::string path = directory_ + "/" + START_FILE;
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        if (errno == ENOENT) {
+            return 0;
+        }
+        throw_errno("failed to open " + path);
+    }
+
+    start_record rec{};
+    bool ok = pread_fully(fd, &rec, sizeof(rec), 0);
+    ::close(fd);
+
+    // The file is only ever replaced by a rename, so a bad one means the
+    // disk lost data; guessing the start could resurrect compacted logs.
+    if (!ok || checksum(&rec.start_idx_, sizeof(rec.start_idx_)) != rec.crc_) {
+        throw std::runtime_error("corrupt log start file " + path);
+    }
+    return rec.start_idx_;
+}
+
+void segmented_log_store::save_start_locked(ulong start_idx) {
+    std::string path = directory_ + "/" + START_FILE;
+    std::string tmp_path = path + ".tmp";
+
+    start_record rec{};
+    rec.start_idx_ = start_idx;
+    rec.crc_ = checksum(&rec.start_idx_, sizeof(rec.start_idx_));
+
+    int fd = ::open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        throw_errno("failed to create " + tmp_path);
+    }
+
+    try {
+        pwrite_fully(fd, &rec, sizeof(rec), 0);
+        if (fsync_policy_ != log_fsync_policy::never) {
+            sync_fd(fd);
+        }
+    } catch (...) {
+        ::close(fd);
+        throw;
+    }
+    ::close(fd);
+
+    if (::rename(tmp_path.c_str(), path.c_str()) != 0) {
+        throw_errno("failed to replace " + path);
+    }
+    if (fsync_policy_ != log_fsync_policy::never) {
+        sync_directory();
+    }
+}
+
+ulong segmented_log_store::next_slot_locked() const {
+    return segments_.rbegin()->second->next_idx();
+}
+
+void segmented_log_store::append_locked(const ptr<log_entry>& entry) {
+    ptr<buffer> payload = entry->serialize();
+    record_header hdr{static_cast<uint32_t>(payload->size()),
+                      checksum(payload->data_begin(), payload->size())};
+    size_t record_size = sizeof(hdr) + payload->size();
+
+    segment* seg = segments_.rbegin()->second.get();
+    if (!seg->offsets_.empty() && seg->size_ + record_size > segment_size_) {
+        seal_segment(*seg);
+        ulong next_idx = seg->next_idx();
+        create_segment(next_idx);
+        seg = segments_.rbegin()->second.get();
+    }
+
+    // Write the header and payload with a single system call when possible.
+    iovec iov[2] = {{&hdr, sizeof(hdr)},
+                    {payload->data_begin(), payload->size()}};
+    ssize_t n = ::pwritev(seg->fd_, iov, 2, static_cast<off_t>(seg->size_));
+    if (n < 0) {
+        throw_errno("failed to write log segment");
+    } else if (static_cast<size_t>(n) < record_size) {
+        // Finish a short write; `n` may fall within the header or payload.
+        size_t written = static_cast<size_t>(n);
+        if (written < sizeof(hdr)) {
+            pwrite_fully(seg->fd_, reinterpret_cast<char*>(&hdr) + written,
+                         sizeof(hdr) - written, seg->size_ + written);
+            written = sizeof(hdr);
+        }
+        pwrite_fully(seg->fd_,
+                     payload->data_begin() + (written - sizeof(hdr)),
+                     record_size - written, seg->size_ + written);
+    }
+
+    if (fsync_policy_ == log_fsync_policy::always) {
+        sync_fd(seg->fd_);
+    }
+
+    seg->offsets_.push_back(seg->size_);
+    seg->terms_.push_back(entry->get_term());
+    seg->size_ += record_size;
+
+    if (fsync_policy_ == log_fsync_policy::group_commit) {
+        flush_cv_.notify_one();
+    } else if (fsync_policy_ != log_fsync_policy::on_flush) {
+        last_durable_idx_ = seg->next_idx() - 1;
+    }
+}
+
+void segmented_log_store::truncate_locked(ulong index) {
+    // Drop every segment that only holds entries at or after `index`.
+    while (segments_.size() > 1 && segments_.rbegin()->first >= index) {
+        remove_segment(segments_.rbegin()->first);
+    }
+
+    segment& seg = *segments_.rbegin()->second;
+    if (index < seg.base_idx_) {
+        reset_locked(index);
+        return;
+    }
+
+    size_t keep = index - seg.base_idx_;
+    if (keep < seg.offsets_.size()) {
+        uint64_t new_size = seg.offsets_[keep];
+        truncate_fd(seg.fd_, new_size);
+        seg.offsets_.resize(keep);
+        seg.terms_.resize(keep);
+        seg.size_ = new_size;
+    }
+
+    last_durable_idx_ = std::min(last_durable_idx_, index - 1);
+    ++truncate_epoch_;
+    durable_cv_.notify_all();
+}
+
+void segmented_log_store::reset_locked(ulong base_idx) {
+    // The new start and the new segment are made durable before the old
+    // segments go, so that a crash in between never leaves an empty log
+    // that forgot where it starts. The new segment can only be created
+    // after an old one with the same base is removed, so a crash can also
+    // leave the start ahead of every segment; the constructor handles that.
+    save_start_locked(base_idx);
+    remove_segment(base_idx);
+    create_segment(base_idx);
+
+    while (segments_.begin()->first != base_idx) {
+        remove_segment(segments_.begin()->first);
+    }
+    while (segments_.rbegin()->first != base_idx) {
+        remove_segment(segments_.rbegin()->first);
+    }
+
+    start_idx_ = base_idx;
+    last_durable_idx_ = base_idx - 1;
+    ++truncate_epoch_;
+    durable_cv_.notify_all();
+}
+
+ptr<buffer> segmented_log_store::read_payload_locked(ulong index) const {
+    auto it = segments_.upper_bound(index);
+    if (it == segments_.begin()) {
+        return nullptr;
+    }
+
+    const segment& seg = *(--it)->second;
+    size_t pos = index - seg.base_idx_;
+    if (pos >= seg.offsets_.size()) {
+        return nullptr;
+    }
+
+    uint64_t begin = seg.offsets_[pos] + sizeof(record_header);
+    uint64_t end =
+        pos + 1 < seg.offsets_.size() ? seg.offsets_[pos + 1] : seg.size_;
+
+    ptr<buffer> payload = buffer::alloc(end - begin);
+    if (!pread_fully(seg.fd_, payload->data_begin(), end - begin, begin)) {
+        throw std::runtime_error("log segment is shorter than its index");
+    }
+
+    return payload;
+}
+
+ptr<log_entry> segmented_log_store::entry_at_locked(ulong index) const {
+    if (index < start_idx_) {
+        return dummy_entry();
+    }
+
+    ptr<buffer> payload = read_payload_locked(index);
+    if (payload == nullptr) {
+        return dummy_entry();
+    }
+
+    return log_entry::deserialize(*payload);
+}
+
+ulong segmented_log_store::next_slot() const {
+    std::lock_guard<std::mutex> l(lock_);
+    return next_slot_locked();
+}
+
+ulong segmented_log_store::start_index() const {
+    std::lock_guard<std::mutex> l(lock_);
+    return start_idx_;
+}
+
+ptr<log_entry> segmented_log_store::last_entry() const {
+    std::lock_guard<std::mutex> l(lock_);
+    return entry_at_locked(next_slot_locked() - 1);
+}
+
+ulong segmented_log_store::append(ptr<log_entry>& entry) {
+    std::lock_guard<std::mutex> l(lock_);
+    ulong idx = next_slot_locked();
+    append_locked(entry);
+    return idx;
+}
+
+void segmented_log_store::write_at(ulong index, ptr<log_entry>& entry) {
+    std::lock_guard<std::mutex> l(lock_);
+    truncate_locked(index);
+    append_locked(entry);
+}
+
+ptr<std::vector<ptr<log_entry>>> segmented_log_store::log_entries(ulong start,
+                                                                  ulong end) {
+    return log_entries_ext(start, end, 0);
+}
+
+ptr<std::vector<ptr<log_entry>>> segmented_log_store::log_entries_ext(
+    ulong start, ulong end, int64 batch_size_hint_in_bytes) {
+    ptr<std::vector<ptr<log_entry>>> ret =
+        cs_new<std::vector<ptr<log_entry>>>();
+
+    if (batch_size_hint_in_bytes < 0) {
+        return ret;
+    }
+
+    std::lock_guard<std::mutex> l(lock_);
+    size_t accum_size = 0;
+    for (ulong ii = start; ii < end; ++ii) {
+        ptr<log_entry> le = entry_at_locked(ii);
+        accum_size += le->get_buf().size();
+        ret->push_back(std::move(le));
+        if (batch_size_hint_in_bytes &&
+            accum_size >= static_cast<ulong>(batch_size_hint_in_bytes)) {
+            break;
+        }
+    }
+
+    return ret;
+}
+
+ptr<log_entry> segmented_log_store::entry_at(ulong index) {
+    std::lock_guard<std::mutex> l(lock_);
+    return entry_at_locked(index);
+}
+
+ulong segmented_log_store::term_at(ulong index) {
+    std::lock_guard<std::mutex> l(lock_);
+    if (index < start_idx_) {
+        return 0;
+    }
+
+    auto it = segments_.upper_bound(index);
+    if (it == segments_.begin()) {
+        return 0;
+    }
+
+    const segment& seg = *(--it)->second;
+    size_t pos = index - seg.base_idx_;
+    return pos < seg.terms_.size() ? seg.terms_[pos] : 0;
+}
+
+ptr<buffer> segmented_log_store::pack(ulong index, int32 cnt) {
+    if (cnt < 0) {
+        throw std::runtime_error("Packing negative number of logs");
+    }
+
+    // Records are stored as serialized log entries, which is exactly what a
+    // pack carries, so they can be copied out without deserializing them.
+    std::vector<ptr<buffer>> logs;
+    size_t size_total = 0;
+    {
+        std::lock_guard<std::mutex> l(lock_);
+        for (ulong ii = index; ii < index + static_cast<ulong>(cnt); ++ii) {
+            ptr<buffer> payload = read_payload_locked(ii);
+            if (payload == nullptr) {
+                throw std::runtime_error("Packing log that does not exist");
+            }
+            size_total += payload->size();
+            logs.push_back(std::move(payload));
+        }
+    }
+
+    ptr<buffer> buf_out = buffer::alloc(sizeof(int32) +
+                                        logs.size() * sizeof(int32) +
+                                        size_total);
+    buf_out->pos(0);
+    buf_out->put(cnt);
+
+    for (auto& bb : logs) {
+        buf_out->put(static_cast<int32>(bb->size()));
+        buf_out->put(*bb);
+    }
+    return buf_out;
+}
+
+void segmented_log_store::apply_pack(ulong index, buffer& pack) {
+    pack.pos(0);
+    int32 nlogs = pack.get_int();
+    if (nlogs < 0) {
+        throw std::runtime_error("Invalid number of logs (negative)");
+    }
+
+    std::vector<ptr<log_entry>> entries;
+    for (int32 ii = 0; ii < nlogs; ++ii) {
+        int32 buf_size = pack.get_int();
+        if (buf_size < 0) {
+            throw std::runtime_error("Invalid buffer size (negative)");
+        }
+
+        ptr<buffer> buf_local = buffer::alloc(static_cast<size_t>(buf_size));
+        pack.get(buf_local);
+        entries.push_back(log_entry::deserialize(*buf_local));
+    }
+
+    std::lock_guard<std::mutex> l(lock_);
+    if (index > next_slot_locked()) {
+        reset_locked(index);
+    } else {
+        truncate_locked(index);
+        start_idx_ = std::min(start_idx_, index);
+    }
+
+    for (const auto& le : entries) {
+        append_locked(le);
+    }
+}
+
+bool segmented_log_store::compact(ulong last_log_index) {
+    std::lock_guard<std::mutex> l(lock_);
+
+    // Compacting everything (e.g. after installing a snapshot) restarts the
+    // log right after the snapshot.
+    if (last_log_index >= next_slot_locked() - 1) {
+        reset_locked(last_log_index + 1);
+        last_durable_idx_ = last_log_index;
+        return true;
+    }
+
+    // The start is saved before any segment is removed; segments left
+    // below it by a crash are removed on the next open.
+    if (last_log_index + 1 > start_idx_) {
+        save_start_locked(last_log_index + 1);
+    }
+
+    while (segments_.size() > 1 &&
+           segments_.begin()->second->next_idx() - 1 <= last_log_index) {
+        remove_segment(segments_.begin()->first);
+    }
+
+    // WARNING:
+    //   Even though nothing has been erased,
+    //   we should set `start_idx_` to new index.
+    start_idx_ = std::max(start_idx_, last_log_index + 1);
+    return true;
+}
+
+bool segmented_log_store::flush() {
+    if (fsync_policy_ == log_fsync_policy::group_commit) {
+        // Piggyback on the flusher so that concurrent callers share fsyncs.
+        std::unique_lock<std::mutex> l(lock_);
+        ulong target = next_slot_locked() - 1;
+        uint64_t epoch = truncate_epoch_;
+        flush_cv_.notify_one();
+        durable_cv_.wait(l, [&] {
+            return last_durable_idx_ >= target || epoch != truncate_epoch_ ||
+                   stop_flusher_;
+        });
+        return true;
+    }
+
+    std::lock_guard<std::mutex> l(lock_);
+    if (fsync_policy_ == log_fsync_policy::on_flush) {
+        sync_fd(segments_.rbegin()->second->fd_);
+    }
+
+    last_durable_idx_ = next_slot_locked() - 1;
+    return true;
+}
+
+ulong segmented_log_store::last_durable_index() {
+    std::lock_guard<std::mutex> l(lock_);
+    return std::min(last_durable_idx_, next_slot_locked() - 1);
+}
+
+void segmented_log_store::set_raft_server(nuraft::raft_server* raft) {
+    bool notify;
+    {
+        std::lock_guard<std::mutex> l(lock_);
+        raft_server_ = raft;
+        notify = raft != nullptr && completion_pending_;
+        if (notify) {
+            completion_pending_ = false;
+        }
+    }
+
+    // Raft starts appending before the launcher hands it out, and waits for
+    // the completions it missed meanwhile.
+    if (notify) {
+        raft->notify_log_append_completion(true);
+    }
+}
+
+void segmented_log_store::flush_loop() {
+    std::unique_lock<std::mutex> l(lock_);
+    while (true) {
+        flush_cv_.wait(l, [this] {
+            return stop_flusher_ || last_durable_idx_ < next_slot_locked() - 1;
+        });
+        if (stop_flusher_) break;
+
+        // Everything appended up to now is covered by this fsync. Sync a
+        // duplicate descriptor so that the segment can be sealed or removed
+        // while the lock is released.
+        ulong target = next_slot_locked() - 1;
+        uint64_t epoch = truncate_epoch_;
+        int fd = ::dup(segments_.rbegin()->second->fd_);
+        l.unlock();
+
+        // errno is saved first, since writing the message may change it.
+        if (fd < 0) {
+            int err = errno;
+            std::cerr << "FATAL: failed to duplicate Raft log descriptor: "
+                      << std::strerror(err) << " (errno " << err << ")"
+                      << std::endl;
+            std::abort();
+        }
+        if (::fdatasync(fd) != 0) {
+            int err = errno;
+            std::cerr << "FATAL: failed to sync Raft log up to " << target
+                      << ": " << std::strerror(err) << " (errno " << err
+                      << ")" << std::endl;
+            std::abort();
+        }
+        ::close(fd);
+
+        l.lock();
+        if (epoch != truncate_epoch_ || target <= last_durable_idx_) {
+            continue;
+        }
+
+        last_durable_idx_ = target;
+        durable_cv_.notify_all();
+
+        nuraft::raft_server* raft = raft_server_;
+        if (raft != nullptr) {
+            l.unlock();
+            raft->notify_log_append_completion(true);
+            l.lock();
+        } else {
+            completion_pending_ = true;
+        }
+    }
+}
+
+void segmented_log_store::close() {
+    if (flusher_.joinable()) {
+        {
+            std::lock_guard<std::mutex> l(lock_);
+            stop_flusher_ = true;
+        }
+        flush_cv_.notify_all();
+        durable_cv_.notify_all();
+        flusher_.join();
+    }
+
+    std::lock_guard<std::mutex> l(lock_);
+    for (auto& [base_idx, seg] : segments_) {
+        ::close(seg->fd_);
+        ::close(seg->idx_fd_);
+    }
+    segments_.clear();
+}
+
+}  // namespace replicated_splinterdb
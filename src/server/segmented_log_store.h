@@ -0,0 +1,202 @@
+#ifndef REPLICATED_SPLINTERDB_SEGMENTED_LOG_STORE_H
+#define REPLICATED_SPLINTERDB_SEGMENTED_LOG_STORE_H
+
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "libnuraft/log_store.hxx"
+#include "replicated-splinterdb/server/replica_config.h"
+
+namespace nuraft {
+class raft_server;
+}
+
+namespace replicated_splinterdb {
+
+/**
+ * File-backed, append-only Raft log store.
+ *
+ * The log is split into segment files of roughly `segment_size` bytes, each
+ * named after the index of its first entry. Every record in a segment is a
+ * serialized `log_entry` prefixed by its length and CRC32. A sealed segment
+ * also has a sidecar index of (offset, term) pairs, so only the active
+ * segment has to be scanned when the store is reopened. Entry payloads are
+ * never cached in memory; only the per-segment offsets and terms are. The
+ * start index is kept in a file of its own, since compaction can move it
+ * into the middle of a segment.
+ *
+ * With the `group_commit` fsync policy, `append()` only writes the record
+ * and a background thread fsyncs everything appended since its last pass in
+ * one go, then calls `notify_log_append_completion`. This requires
+ * `raft_params::parallel_log_appending_`.
+ */
+class segmented_log_store : public nuraft::log_store {
+  public:
+    segmented_log_store(const std::string& directory, size_t segment_size,
+                        log_fsync_policy fsync_policy);
+
+    ~segmented_log_store() override;
+
+    segmented_log_store(const segmented_log_store&) = delete;
+
+    segmented_log_store& operator=(const segmented_log_store&) = delete;
+
+    nuraft::ulong next_slot() const override;
+
+    nuraft::ulong start_index() const override;
+
+    nuraft::ptr<nuraft::log_entry> last_entry() const override;
+
+    nuraft::ulong append(nuraft::ptr<nuraft::log_entry>& entry) override;
+
+    void write_at(nuraft::ulong index,
+                  nuraft::ptr<nuraft::log_entry>& entry) override;
+
+    nuraft::ptr<std::vector<nuraft::ptr<nuraft::log_entry>>> log_entries(
+        nuraft::ulong start, nuraft::ulong end) override;
+
+    nuraft::ptr<std::vector<nuraft::ptr<nuraft::log_entry>>> log_entries_ext(
+        nuraft::ulong start, nuraft::ulong end,
+        nuraft::int64 batch_size_hint_in_bytes = 0) override;
+
+    nuraft::ptr<nuraft::log_entry> entry_at(nuraft::ulong index) override;
+
+    nuraft::ulong term_at(nuraft::ulong index) override;
+
+    nuraft::ptr<nuraft::buffer> pack(nuraft::ulong index,
+                                     nuraft::int32 cnt) override;
+
+    void apply_pack(nuraft::ulong index, nuraft::buffer& pack) override;
+
+    bool compact(nuraft::ulong last_log_index) override;
+
+    bool flush() override;
+
+    nuraft::ulong last_durable_index() override;
+
+    void close();
+
+    /**
+     * Set the Raft server to notify once appended logs become durable.
+     * Only used with the `group_commit` fsync policy. If logs became
+     * durable before it was set, the server is notified right away.
+     *
+     * @param raft Raft server, or `nullptr` to stop notifying.
+     */
+    void set_raft_server(nuraft::raft_server* raft);
+
+  private:
+    struct record_header {
+        uint32_t length_;
+        uint32_t crc_;
+    };
+
+    struct index_entry {
+        uint64_t offset_;
+        uint64_t term_;
+    };
+
+    struct start_record {
+        uint64_t start_idx_;
+        uint32_t crc_;
+    };
+
+    struct segment {
+        nuraft::ulong base_idx_;
+        int fd_;
+        int idx_fd_;
+        uint64_t size_;
+        std::vector<uint64_t> offsets_;
+        std::vector<nuraft::ulong> terms_;
+
+        nuraft::ulong next_idx() const { return base_idx_ + offsets_.size(); }
+    };
+
+    std::string segment_path(nuraft::ulong base_idx, const char* ext) const;
+
+    void open_segment(nuraft::ulong base_idx, bool active);
+
+    void create_segment(nuraft::ulong base_idx);
+
+    void remove_segment(nuraft::ulong base_idx);
+
+    void seal_segment(segment& seg);
+
+    void scan_segment(segment& seg, size_t first_unindexed);
+
+    void append_locked(const nuraft::ptr<nuraft::log_entry>& entry);
+
+    void truncate_locked(nuraft::ulong index);
+
+    void reset_locked(nuraft::ulong base_idx);
+
+    // The start index saved by the last compaction or reset, or 0 if there
+    // is none.
+    nuraft::ulong load_start() const;
+
+    // Atomically replace the saved start index.
+    void save_start_locked(nuraft::ulong start_idx);
+
+    nuraft::ulong next_slot_locked() const;
+
+    nuraft::ptr<nuraft::buffer> read_payload_locked(nuraft::ulong index) const;
+
+    nuraft::ptr<nuraft::log_entry> entry_at_locked(nuraft::ulong index) const;
+
+    void sync_directory() const;
+
+    void flush_loop();
+
+    // Directory holding the segment and index files.
+    std::string directory_;
+
+    // Soft limit on the size of a segment file, in bytes.
+    size_t segment_size_;
+
+    log_fsync_policy fsync_policy_;
+
+    // Segments by the index of their first entry. The last one is active.
+    std::map<nuraft::ulong, std::unique_ptr<segment>> segments_;
+
+    // Lock for `segments_` and the files behind them.
+    mutable std::mutex lock_;
+
+    // The index of the first log. May be larger than the base index of the
+    // first segment if the log was compacted in the middle of that segment.
+    nuraft::ulong start_idx_;
+
+    // The last log index known to be on disk.
+    nuraft::ulong last_durable_idx_;
+
+    // Bumped whenever logs are truncated, so that an fsync that started
+    // before the truncation does not mark the rewritten logs as durable.
+    uint64_t truncate_epoch_;
+
+    // Backward pointer to Raft server.
+    nuraft::raft_server* raft_server_;
+
+    // Whether logs became durable while `raft_server_` was not set yet, so
+    // that Raft is told once it is.
+    bool completion_pending_;
+
+    // Background flusher for the `group_commit` fsync policy.
+    std::thread flusher_;
+
+    // Signalled when there are logs for the flusher to sync.
+    std::condition_variable flush_cv_;
+
+    // Signalled when `last_durable_idx_` advances.
+    std::condition_variable durable_cv_;
+
+    // Flag to terminate the flusher.
+    bool stop_flusher_;
+};
+
+}  // namespace replicated_splinterdb
+
+#endif  // REPLICATED_SPLINTERDB_SEGMENTED_LOG_STORE_H
@@ -1,14 +1,22 @@
 #include "replicated-splinterdb/server/server.h"
 
+#include <algorithm>
+#include <chrono>
+#include <future>
 #include <iostream>
+#include <memory>
+#include <string_view>
 
+#include "hot_key_sketch.h"
 #include "libnuraft/buffer_serializer.hxx"
+#include "lookup_pool.h"
 #include "replicated-splinterdb/common/rpc.h"
 #include "replicated-splinterdb/common/types.h"
 
 namespace replicated_splinterdb {
 
 using nuraft::buffer;
+using nuraft::buffer_serializer;
 using nuraft::cmd_result_code;
 using nuraft::ptr;
 using std::string;
@@ -18,7 +26,18 @@ server::server(uint16_t client_port, uint16_t join_port,
                const replica_config& cfg)
     : replica_instance_{cfg},
       client_srv_{cfg.addr_, client_port},
-      join_srv_{cfg.addr_, join_port} {
+      join_srv_{cfg.addr_, join_port},
+      lookup_pool_(nullptr),
+      hot_keys_(nullptr),
+      leader_client_(nullptr),
+      leader_client_id_(-1),
+      leader_client_lock_() {
+    lookup_pool_ = std::make_unique<lookup_pool>(
+        cfg.lookup_threads_, [this] { replica_instance_.register_thread(); });
+    if (cfg.hot_key_capacity_ > 0) {
+        hot_keys_ = std::make_unique<hot_key_sketch>(cfg.hot_key_capacity_);
+    }
+
     initialize();
 
     client_srv_.set_worker_init_func(
@@ -42,29 +61,175 @@ void server::run(uint64_t nthreads) {
     join_srv_.run();
 }
 
-static rpc_mutation_result extract_result(ptr<replica::raft_result> result) {
+static rpc_mutation_result extract_result(replica::raft_result& result,
+                                          ptr<std::exception>& err) {
     int32_t spl_rc = 0;
     int32_t raft_rc = 999;
 
-    if (!result->get_accepted()) {
+    if (err != nullptr) {
+        std::cout << "WARNING: commit failed: " << err->what() << std::endl;
+    }
+
+    if (!result.get_accepted()) {
         std::cout << "WARNING: log append failed." << std::endl;
-        raft_rc = result->get_result_code();
-    } else if (!result->has_result()) {
+        raft_rc = result.get_result_code();
+    } else if (!result.has_result()) {
         std::cout << "WARNING: SM did not yield result yet" << std::endl;
-        raft_rc = result->get_result_code();
+        raft_rc = result.get_result_code();
     } else {
-        raft_rc = result->get_result_code();
-        ptr<buffer> buf = result->get();
+        raft_rc = result.get_result_code();
+        ptr<buffer> buf = result.get();
 
         if (buf != nullptr) {
-            spl_rc = buf->get_int();
+            // Result buffers are shared, so read without moving their cursor.
+            buffer_serializer bs(*buf);
+            spl_rc = bs.get_i32();
         } else {
             std::cout << "WARNING: GOT nullptr RESULT (raft_rc=" << raft_rc
-                      << ", " << result->get_result_str() << ")" << std::endl;
+                      << ", " << result.get_result_str() << ")" << std::endl;
         }
     }
 
-    return {spl_rc, raft_rc, result->get_result_str()};
+    return {spl_rc, raft_rc, result.get_result_str()};
+}
+
+rpc_mutation_result server::replicate(const splinterdb_operation& op) {
+    // rpclib sends the response when the handler returns, so the worker
+    // blocks here until the log commits or the client timeout passes, and
+    // writes in flight are capped by the number of workers whichever return
+    // method is used. The promise is shared with the callback, which may
+    // still run after a timed out wait has returned.
+    auto outcome = std::make_shared<std::promise<rpc_mutation_result>>();
+    std::future<rpc_mutation_result> done = outcome->get_future();
+    replica_instance_.append_log(
+        op, [outcome](ptr<Timer>, replica::raft_result& result,
+                      ptr<std::exception>& err) {
+            outcome->set_value(extract_result(result, err));
+        });
+
+    // NuRaft may never call back, e.g. if it loses leadership with the log
+    // still uncommitted, so the worker gives up after the client timeout.
+    rpc_mutation_result result =
+        done.wait_for(std::chrono::milliseconds(
+            replica_instance_.get_client_timeout_ms())) ==
+                std::future_status::ready
+            ? done.get()
+            : rpc_mutation_result{0, cmd_result_code::TIMEOUT,
+                                  "timed out waiting for the log to commit"};
+    result.set_leader_id(replica_instance_.get_leader());
+    return result;
+}
+
+// Number of keys of a multi-get that one thread looks up at a time.
+static constexpr size_t MULTI_GET_CHUNK_SIZE = 8;
+
+// Default and maximum number of entries in a page of scan results.
+static constexpr uint32_t SCAN_DEFAULT_LIMIT = 1000;
+
+// A page of scan results is cut short once it holds this many bytes.
+static constexpr size_t SCAN_MAX_PAGE_BYTES = 1024 * 1024;
+
+// How long a consistent read waits for the local replica to catch up.
+static constexpr uint64_t READ_SYNC_TIMEOUT_MS = 3000;
+
+// How long the leader waits to confirm its leadership for a read index. It is
+// shorter than the read sync timeout so that a follower asking for the read
+// index hears back before its own call times out.
+static constexpr uint64_t LEADER_CONFIRM_TIMEOUT_MS = READ_SYNC_TIMEOUT_MS / 2;
+
+std::shared_ptr<rpc::client> server::get_leader_client(int32_t leader_id) {
+    std::lock_guard<std::mutex> guard(leader_client_lock_);
+    if (leader_client_ != nullptr && leader_client_id_ == leader_id &&
+        leader_client_->get_connection_state() !=
+            rpc::client::connection_state::disconnected) {
+        return leader_client_;
+    }
+
+    ptr<nuraft::srv_config> leader =
+        replica_instance_.get_server_info(leader_id);
+    if (leader == nullptr) {
+        return nullptr;
+    }
+
+    const string& endpoint = leader->get_aux();
+    auto delim_idx = endpoint.find(':');
+    int port = std::stoi(endpoint.substr(delim_idx + 1));
+    if (1 > port || port > 65535) {
+        return nullptr;
+    }
+
+    leader_client_ = std::make_shared<rpc::client>(
+        endpoint.substr(0, delim_idx), static_cast<uint16_t>(port));
+    leader_client_->set_timeout(static_cast<int64_t>(READ_SYNC_TIMEOUT_MS));
+    leader_client_id_ = leader_id;
+    return leader_client_;
+}
+
+int64_t server::leader_read_index() {
+    if (!replica_instance_.has_leader_lease()) {
+        return READ_RC_NOT_LEADER;
+    }
+    // The commit index covers every write acknowledged before this point,
+    // but only if no other replica has been elected since, which the
+    // confirmation round rules out.
+    int64_t read_idx =
+        static_cast<int64_t>(replica_instance_.get_committed_index());
+    if (!replica_instance_.confirm_leadership(LEADER_CONFIRM_TIMEOUT_MS)) {
+        return READ_RC_NOT_LEADER;
+    }
+    return read_idx;
+}
+
+int64_t server::fetch_read_index() {
+    int32_t leader_id = replica_instance_.get_leader();
+    if (leader_id < 0) {
+        return READ_RC_NO_LEADER;
+    }
+
+    try {
+        std::shared_ptr<rpc::client> leader = get_leader_client(leader_id);
+        if (leader == nullptr) {
+            return READ_RC_NO_LEADER;
+        }
+        return leader->call(RPC_GET_READ_INDEX).as<int64_t>();
+    } catch (const std::exception& e) {
+        std::cout << "WARNING: failed to get read index from leader "
+                  << leader_id << ": " << e.what() << std::endl;
+        return READ_RC_NO_LEADER;
+    }
+}
+
+int32_t server::sync_for_read(read_consistency consistency) {
+    int64_t read_idx = 0;
+    switch (consistency) {
+        case read_consistency::local:
+            return 0;
+        case read_consistency::lease:
+            if (!replica_instance_.has_leader_lease()) {
+                return READ_RC_NOT_LEADER;
+            }
+            read_idx =
+                static_cast<int64_t>(replica_instance_.get_committed_index());
+            break;
+        case read_consistency::read_index:
+            read_idx = replica_instance_.get_leader() ==
+                               replica_instance_.get_id()
+                           ? leader_read_index()
+                           : fetch_read_index();
+            break;
+        default:
+            throw std::invalid_argument("unknown read consistency");
+    }
+
+    if (read_idx < 0) {
+        return static_cast<int32_t>(read_idx);
+    }
+
+    if (!replica_instance_.wait_for_commit(static_cast<uint64_t>(read_idx),
+                                           READ_SYNC_TIMEOUT_MS)) {
+        return READ_RC_TIMED_OUT;
+    }
+    return 0;
 }
 
 void server::initialize() {
@@ -94,6 +259,10 @@ void server::initialize() {
     // void -> std::string
     client_srv_.bind(RPC_PING, []() { return "pong"; });
 
+    // void -> uint32_t
+    client_srv_.bind(RPC_GET_PROTOCOL_VERSION,
+                     []() { return uint32_t{RPC_PROTOCOL_VERSION}; });
+
     // void -> int32_t
     client_srv_.bind(RPC_GET_SRV_ID,
                      [this]() { return replica_instance_.get_id(); });
@@ -115,8 +284,23 @@ void server::initialize() {
         return rpc_cluster_endpoints{std::move(result)};
     });
 
-    // string -> rpc_read_result
-    client_srv_.bind(RPC_SPLINTERDB_GET, [this](string key) {
+    // void -> int64_t
+    client_srv_.bind(RPC_GET_READ_INDEX,
+                     [this]() -> int64_t { return leader_read_index(); });
+
+    // (string, uint8_t) -> rpc_read_result
+    client_srv_.bind(RPC_SPLINTERDB_GET, [this](string key,
+                                                uint8_t consistency) {
+        int32_t sync_rc =
+            sync_for_read(static_cast<read_consistency>(consistency));
+        if (sync_rc != 0) {
+            return rpc_read_result{sync_rc};
+        }
+
+        if (hot_keys_ != nullptr) {
+            hot_keys_->record(key);
+        }
+
         slice key_slice = slice_create(key.size(), key.data());
         auto [data, rc] = replica_instance_.read(std::move(key_slice));
 
@@ -127,31 +311,154 @@ void server::initialize() {
         }
     });
 
+    // (vector<string>, uint8_t) -> rpc_multi_read_result
+    client_srv_.bind(RPC_SPLINTERDB_MULTI_GET, [this](vector<string> keys,
+                                                      uint8_t consistency) {
+        rpc_multi_read_result results{keys.size()};
+
+        int32_t sync_rc =
+            sync_for_read(static_cast<read_consistency>(consistency));
+        if (sync_rc != 0) {
+            for (size_t i = 0; i < keys.size(); ++i) {
+                results.set_rc(i, sync_rc);
+            }
+            return results;
+        }
+
+        size_t num_chunks =
+            (keys.size() + MULTI_GET_CHUNK_SIZE - 1) / MULTI_GET_CHUNK_SIZE;
+        lookup_pool_->parallel_for(num_chunks, [&](size_t chunk) {
+            size_t end =
+                std::min(keys.size(), (chunk + 1) * MULTI_GET_CHUNK_SIZE);
+            for (size_t i = chunk * MULTI_GET_CHUNK_SIZE; i < end; ++i) {
+                if (hot_keys_ != nullptr) {
+                    hot_keys_->record(keys[i]);
+                }
+                slice key_slice = slice_create(keys[i].size(), keys[i].data());
+                results.set_rc(
+                    i, replica_instance_.read(key_slice, results.value(i)));
+            }
+        });
+
+        return results;
+    });
+
+    // uint32_t -> rpc_hot_keys
+    //
+    // The `limit` keys this replica has looked up most often lately.
+    client_srv_.bind(RPC_SPLINTERDB_HOT_KEYS, [this](uint32_t limit) {
+        rpc_hot_keys result;
+        if (hot_keys_ == nullptr) {
+            return result;
+        }
+
+        for (auto& [key, count] : hot_keys_->top(limit)) {
+            result.add(std::move(key), count);
+        }
+        return result;
+    });
+
+    // (string, string, uint32_t, uint8_t) -> rpc_scan_result
+    //
+    // Returns the keys in [start_key, end_key), or from `start_key` on if
+    // `end_key` is empty, a page at a time. A page holds at most `limit`
+    // entries; if there are more, the next page starts at its resume key.
+    client_srv_.bind(RPC_SPLINTERDB_SCAN, [this](string start_key,
+                                                 string end_key, uint32_t limit,
+                                                 uint8_t consistency) {
+        int32_t sync_rc =
+            sync_for_read(static_cast<read_consistency>(consistency));
+        if (sync_rc != 0) {
+            return rpc_scan_result{sync_rc};
+        }
+
+        if (limit == 0 || limit > SCAN_DEFAULT_LIMIT) {
+            limit = SCAN_DEFAULT_LIMIT;
+        }
+
+        rpc_scan_result page{0};
+        size_t page_bytes = 0;
+        slice start = start_key.empty()
+                          ? NULL_SLICE
+                          : slice_create(start_key.size(), start_key.data());
+
+        int32_t rc = replica_instance_.scan(start, [&](slice key, slice value) {
+            std::string_view key_view{static_cast<const char*>(key.data),
+                                      static_cast<size_t>(key.length)};
+            if (!end_key.empty() && key_view >= end_key) {
+                return false;
+            }
+
+            if (page.size() == limit || page_bytes >= SCAN_MAX_PAGE_BYTES) {
+                page.set_resume_key(std::string(key_view));
+                return false;
+            }
+
+            page_bytes += key.length + value.length;
+            page.add(std::string(key_view),
+                     std::string(static_cast<const char*>(value.data),
+                                 static_cast<size_t>(value.length)));
+            return true;
+        });
+
+        if (rc != 0) {
+            return rpc_scan_result{rc};
+        }
+        return page;
+    });
+
     // (string, string) -> rpc_mutation_result
     client_srv_.bind(RPC_SPLINTERDB_PUT, [this](string key, string value) {
         splinterdb_operation op{
             splinterdb_operation::make_put(std::move(key), std::move(value))};
-        ptr<replica::raft_result> result = replica_instance_.append_log(op);
-
-        return extract_result(result);
+        return replicate(op);
     });
 
     // string -> rpc_mutation_result
     client_srv_.bind(RPC_SPLINTERDB_DELETE, [this](string key) {
         splinterdb_operation op{
             splinterdb_operation::make_delete(std::move(key))};
-        ptr<replica::raft_result> result = replica_instance_.append_log(op);
+        return replicate(op);
+    });
+
+    // rpc_write_batch -> rpc_mutation_result
+    client_srv_.bind(RPC_SPLINTERDB_WRITE_BATCH, [this](rpc_write_batch batch) {
+        if (batch.empty()) {
+            return rpc_mutation_result{0, 0, ""};
+        }
 
-        return extract_result(result);
+        std::vector<splinterdb_operation> ops;
+        ops.reserve(batch.size());
+        for (auto& [type, key, value] : batch.ops()) {
+            switch (type) {
+                case rpc_write_batch::PUT:
+                    ops.push_back(splinterdb_operation::make_put(
+                        std::move(key), std::move(value)));
+                    break;
+                case rpc_write_batch::UPDATE:
+                    // Same as RPC_SPLINTERDB_UPDATE outside a batch.
+                    ops.push_back(splinterdb_operation::make_put(
+                        std::move(key), std::move(value)));
+                    break;
+                case rpc_write_batch::DELETE:
+                    ops.push_back(
+                        splinterdb_operation::make_delete(std::move(key)));
+                    break;
+                default:
+                    throw std::invalid_argument("unknown batch operation");
+            }
+        }
+
+        splinterdb_operation op{
+            splinterdb_operation::make_batch(std::move(ops))};
+        return replicate(op);
     });
 
     // (string, string) -> rpc_mutation_result
     client_srv_.bind(RPC_SPLINTERDB_UPDATE, [this](string key, string value) {
         splinterdb_operation op{
             splinterdb_operation::make_put(std::move(key), std::move(value))};
-        ptr<replica::raft_result> result = replica_instance_.append_log(op);
-
-        return extract_result(result);
+        return replicate(op);
     });
 }
 
@@ -1,5 +1,10 @@
 #include "replicated-splinterdb/server/splinterdb_operation.h"
 
+#include <zlib.h>
+
+#include <algorithm>
+#include <stdexcept>
+
 #include "libnuraft/buffer.hxx"
 
 namespace replicated_splinterdb {
@@ -8,21 +13,205 @@ using nuraft::buffer;
 using nuraft::buffer_serializer;
 using nuraft::ptr;
 
-ptr<buffer> splinterdb_operation::serialize() const {
-    size_t buffer_size = sizeof(type_) + sizeof(uint32_t) + key_.size();
-    if (value_.has_value()) {
-        buffer_size += sizeof(uint32_t) + value_.value().size();
+// Payloads in the original format start with the operation type, which is
+// always below 0x80. Later formats start with 0x80 | version instead.
+static constexpr uint8_t FORMAT_VERSION_MARKER = 0x80;
+static constexpr uint8_t FORMAT_V1 = FORMAT_VERSION_MARKER | 1;
+
+// Per-operation flags in the v1 format.
+static constexpr uint8_t OP_VALUE_COMPRESSED = 0x1;
+
+// The fewest bytes a v1 operation takes: type, flags and an empty key.
+static constexpr size_t MIN_V1_OP_SIZE = 3;
+
+static bool has_value(splinterdb_operation::splinterdb_operation_type type) {
+    return type == splinterdb_operation::PUT ||
+           type == splinterdb_operation::UPDATE;
+}
+
+// Return the format version of a log payload, or 0 for the original format.
+static uint8_t payload_format(const buffer& payload) {
+    if (payload.size() == 0) {
+        throw std::runtime_error("empty log payload");
     }
 
-    ptr<buffer> buf = buffer::alloc(buffer_size);
-    buffer_serializer bs(buf);
+    uint8_t first = payload.data_begin()[0];
+    if (first < FORMAT_VERSION_MARKER) {
+        return 0;
+    }
+    if (first != FORMAT_V1) {
+        throw std::runtime_error("unsupported log payload format");
+    }
+    return first;
+}
+
+static size_t varint_size(uint64_t val) {
+    size_t size = 1;
+    while (val >= 0x80) {
+        val >>= 7;
+        ++size;
+    }
+    return size;
+}
+
+static void put_varint(buffer_serializer& bs, uint64_t val) {
+    while (val >= 0x80) {
+        bs.put_u8(static_cast<uint8_t>(val | 0x80));
+        val >>= 7;
+    }
+    bs.put_u8(static_cast<uint8_t>(val));
+}
+
+static uint64_t get_varint(buffer_serializer& bs) {
+    uint64_t val = 0;
+    for (unsigned shift = 0; shift < 64; shift += 7) {
+        uint8_t byte = bs.get_u8();
+        val |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            return val;
+        }
+    }
+    throw std::runtime_error("malformed varint in log payload");
+}
+
+// Read the number of operations in a v1 batch. It is checked against what
+// is left of the payload, so a corrupt count cannot cause a huge allocation.
+static size_t get_batch_count(buffer_serializer& bs) {
+    uint64_t count = get_varint(bs);
+    size_t remaining = bs.size() - bs.pos();
+    if (count > remaining / MIN_V1_OP_SIZE) {
+        throw std::runtime_error("batch count exceeds log payload");
+    }
+    return static_cast<size_t>(count);
+}
+
+static std::string_view get_varint_bytes(buffer_serializer& bs) {
+    auto len = static_cast<size_t>(get_varint(bs));
+    return {static_cast<const char*>(bs.get_raw(len)), len};
+}
+
+static void inflate_into(std::string_view compressed, size_t raw_len,
+                         std::string& out) {
+    out.resize(raw_len);
+    uLongf dest_len = raw_len;
+    if (uncompress(reinterpret_cast<Bytef*>(out.data()), &dest_len,
+                   reinterpret_cast<const Bytef*>(compressed.data()),
+                   static_cast<uLong>(compressed.size())) != Z_OK ||
+        dest_len != raw_len) {
+        throw std::runtime_error("corrupted compressed value in log payload");
+    }
+}
+
+// Compress the values of `op` (or of its sub-operations) that reach
+// `threshold`, appending one entry per leaf operation to `out`. An empty
+// entry means the value is stored as-is.
+static void compress_values(const splinterdb_operation& op, size_t threshold,
+                            std::vector<std::string>& out) {
+    if (op.type() == splinterdb_operation::BATCH) {
+        for (const auto& sub_op : op.batch()) {
+            compress_values(sub_op, threshold, out);
+        }
+        return;
+    }
+
+    std::string& compressed = out.emplace_back();
+    if (threshold == 0 || !has_value(op.type()) ||
+        op.value().size() < threshold) {
+        return;
+    }
+
+    const std::string& raw = op.value();
+    uLongf compressed_len = compressBound(static_cast<uLong>(raw.size()));
+    compressed.resize(compressed_len);
+    int rc = compress2(reinterpret_cast<Bytef*>(compressed.data()),
+                       &compressed_len,
+                       reinterpret_cast<const Bytef*>(raw.data()),
+                       static_cast<uLong>(raw.size()), Z_BEST_SPEED);
+
+    if (rc == Z_OK && compressed_len < raw.size()) {
+        compressed.resize(compressed_len);
+    } else {
+        compressed.clear();
+    }
+}
+
+static size_t encoded_size(const splinterdb_operation& op,
+                           const std::vector<std::string>& compressed,
+                           size_t& leaf) {
+    size_t size = 2 * sizeof(uint8_t);
+    if (op.type() == splinterdb_operation::BATCH) {
+        size += varint_size(op.batch().size());
+        for (const auto& sub_op : op.batch()) {
+            size += encoded_size(sub_op, compressed, leaf);
+        }
+        return size;
+    }
+
+    size += varint_size(op.key().size()) + op.key().size();
+    const std::string& packed = compressed[leaf++];
+    if (!packed.empty()) {
+        size += varint_size(op.value().size());
+        size += varint_size(packed.size()) + packed.size();
+    } else if (has_value(op.type())) {
+        size += varint_size(op.value().size()) + op.value().size();
+    }
+    return size;
+}
+
+static void encode(const splinterdb_operation& op,
+                   const std::vector<std::string>& compressed, size_t& leaf,
+                   buffer_serializer& bs) {
+    bs.put_u8(op.type());
+    if (op.type() == splinterdb_operation::BATCH) {
+        bs.put_u8(0);
+        put_varint(bs, op.batch().size());
+        for (const auto& sub_op : op.batch()) {
+            encode(sub_op, compressed, leaf, bs);
+        }
+        return;
+    }
 
-    bs.put_u8(type_);
-    bs.put_str(key_);
-    if (value_.has_value()) {
-        bs.put_str(value_.value());
+    const std::string& packed = compressed[leaf++];
+    bs.put_u8(packed.empty() ? 0 : OP_VALUE_COMPRESSED);
+    put_varint(bs, op.key().size());
+    bs.put_raw(op.key().data(), op.key().size());
+
+    if (!packed.empty()) {
+        put_varint(bs, op.value().size());
+        put_varint(bs, packed.size());
+        bs.put_raw(packed.data(), packed.size());
+    } else if (has_value(op.type())) {
+        put_varint(bs, op.value().size());
+        bs.put_raw(op.value().data(), op.value().size());
+    }
+}
+
+static bool has_merge(const splinterdb_operation& op) {
+    if (op.type() == splinterdb_operation::BATCH) {
+        return std::any_of(op.batch().begin(), op.batch().end(), has_merge);
     }
+    return op.type() == splinterdb_operation::UPDATE;
+}
 
+ptr<buffer> splinterdb_operation::serialize(size_t compress_threshold) const {
+    // Snapshots are read live and may carry writes past their log index,
+    // which the follower then replays. That is only harmless for operations
+    // that overwrite or delete a whole key.
+    if (has_merge(*this)) {
+        throw std::invalid_argument("merge updates cannot be logged");
+    }
+
+    std::vector<std::string> compressed;
+    compress_values(*this, compress_threshold, compressed);
+
+    size_t leaf = 0;
+    ptr<buffer> buf = buffer::alloc(sizeof(FORMAT_V1) +
+                                    encoded_size(*this, compressed, leaf));
+
+    buffer_serializer bs(buf);
+    bs.put_u8(FORMAT_V1);
+    leaf = 0;
+    encode(*this, compressed, leaf, bs);
     return buf;
 }
 
@@ -31,21 +220,73 @@ splinterdb_operation::splinterdb_operation(std::string&& key,
                                            splinterdb_operation_type type)
     : key_(std::forward<std::string>(key)),
       value_(std::forward<std::optional<std::string>>(value)),
-      type_(type) {}
+      type_(type),
+      batch_() {}
 
-splinterdb_operation splinterdb_operation::deserialize(buffer& payload_in) {
-    buffer_serializer bs(payload_in);
+static splinterdb_operation make_operation(
+    splinterdb_operation::splinterdb_operation_type type, std::string&& key,
+    std::string&& value) {
+    switch (type) {
+        case splinterdb_operation::PUT:
+            return splinterdb_operation::make_put(std::move(key),
+                                                  std::move(value));
+        case splinterdb_operation::UPDATE:
+            return splinterdb_operation::make_update(std::move(key),
+                                                     std::move(value));
+        case splinterdb_operation::DELETE:
+            return splinterdb_operation::make_delete(std::move(key));
+        default:
+            throw std::runtime_error("unknown operation type in log payload");
+    }
+}
 
-    auto opty = static_cast<splinterdb_operation_type>(bs.get_u8());
-    std::string key_buf = bs.get_str();
+// Decode the original format: a type byte followed by 32-bit length
+// prefixed keys and values.
+static splinterdb_operation deserialize_legacy(buffer_serializer& bs) {
+    using op_type = splinterdb_operation::splinterdb_operation_type;
+    auto type = static_cast<op_type>(bs.get_u8());
+    std::string key = bs.get_str();
+    std::string value = has_value(type) ? bs.get_str() : std::string();
+    return make_operation(type, std::move(key), std::move(value));
+}
+
+static splinterdb_operation deserialize_v1(buffer_serializer& bs,
+                                           bool in_batch) {
+    using op_type = splinterdb_operation::splinterdb_operation_type;
+    auto type = static_cast<op_type>(bs.get_u8());
+    uint8_t flags = bs.get_u8();
 
-    std::optional<std::string> value_buf;
-    if (opty == splinterdb_operation::PUT ||
-        opty == splinterdb_operation::UPDATE) {
-        value_buf = bs.get_str();
+    if (type == splinterdb_operation::BATCH) {
+        if (in_batch) {
+            throw std::runtime_error("nested batch in log payload");
+        }
+        size_t count = get_batch_count(bs);
+        std::vector<splinterdb_operation> ops;
+        ops.reserve(count);
+        for (size_t i = 0; i < count; ++i) {
+            ops.push_back(deserialize_v1(bs, true));
+        }
+        return splinterdb_operation::make_batch(std::move(ops));
     }
 
-    return splinterdb_operation{std::move(key_buf), std::move(value_buf), opty};
+    std::string key{get_varint_bytes(bs)};
+    std::string value;
+    if (flags & OP_VALUE_COMPRESSED) {
+        auto raw_len = static_cast<size_t>(get_varint(bs));
+        inflate_into(get_varint_bytes(bs), raw_len, value);
+    } else if (has_value(type)) {
+        value = get_varint_bytes(bs);
+    }
+    return make_operation(type, std::move(key), std::move(value));
+}
+
+splinterdb_operation splinterdb_operation::deserialize(buffer& payload_in) {
+    buffer_serializer bs(payload_in);
+    if (payload_format(payload_in) == FORMAT_V1) {
+        bs.get_u8();
+        return deserialize_v1(bs, false);
+    }
+    return deserialize_legacy(bs);
 }
 
 splinterdb_operation splinterdb_operation::make_put(std::string&& key,
@@ -65,4 +306,80 @@ splinterdb_operation splinterdb_operation::make_delete(std::string&& key) {
                                 DELETE};
 }
 
-}  // namespace replicated_splinterdb
\ No newline at end of file
+splinterdb_operation splinterdb_operation::make_batch(
+    std::vector<splinterdb_operation>&& ops) {
+    for (const auto& op : ops) {
+        if (op.type() == BATCH) {
+            throw std::invalid_argument("batches cannot be nested");
+        }
+    }
+
+    splinterdb_operation batch{std::string(), std::nullopt, BATCH};
+    batch.batch_ = std::forward<std::vector<splinterdb_operation>>(ops);
+    return batch;
+}
+
+static std::string_view get_view(buffer_serializer& bs) {
+    size_t len = 0;
+    const void* data = bs.get_bytes(len);
+    return {static_cast<const char*>(data), len};
+}
+
+splinterdb_operation_view splinterdb_operation_view::decode_legacy(
+    buffer_serializer& bs) {
+    splinterdb_operation_view view;
+    view.type_ = static_cast<operation_type>(bs.get_u8());
+    if (view.type_ != splinterdb_operation::PUT &&
+        view.type_ != splinterdb_operation::UPDATE &&
+        view.type_ != splinterdb_operation::DELETE) {
+        throw std::runtime_error("unknown operation type in log payload");
+    }
+
+    view.key_ = get_view(bs);
+    if (has_value(view.type_)) {
+        view.value_ = get_view(bs);
+    }
+    return view;
+}
+
+splinterdb_operation_view splinterdb_operation_view::decode_v1(
+    buffer_serializer& bs, bool in_batch) {
+    splinterdb_operation_view view;
+    view.type_ = static_cast<operation_type>(bs.get_u8());
+    uint8_t flags = bs.get_u8();
+
+    if (view.type_ == splinterdb_operation::BATCH) {
+        if (in_batch) {
+            throw std::runtime_error("nested batch in log payload");
+        }
+        size_t count = get_batch_count(bs);
+        view.batch_.reserve(count);
+        for (size_t i = 0; i < count; ++i) {
+            view.batch_.push_back(decode_v1(bs, true));
+        }
+        return view;
+    }
+
+    view.key_ = get_varint_bytes(bs);
+    if (flags & OP_VALUE_COMPRESSED) {
+        auto raw_len = static_cast<size_t>(get_varint(bs));
+        view.inflated_ = std::make_unique<std::string>();
+        inflate_into(get_varint_bytes(bs), raw_len, *view.inflated_);
+        view.value_ = *view.inflated_;
+    } else if (has_value(view.type_)) {
+        view.value_ = get_varint_bytes(bs);
+    }
+    return view;
+}
+
+splinterdb_operation_view splinterdb_operation_view::decode(
+    buffer& payload_in) {
+    buffer_serializer bs(payload_in);
+    if (payload_format(payload_in) == FORMAT_V1) {
+        bs.get_u8();
+        return decode_v1(bs, false);
+    }
+    return decode_legacy(bs);
+}
+
+}  // namespace replicated_splinterdb
@@ -1,6 +1,9 @@
 #ifndef REPLICATED_SPLINTERDB_SPLINTERDB_SNAPSHOT_H
 #define REPLICATED_SPLINTERDB_SPLINTERDB_SNAPSHOT_H
 
+#include <map>
+#include <string>
+
 #include "libnuraft/nuraft.hxx"
 
 namespace replicated_splinterdb {
@@ -12,6 +15,17 @@ struct splinterdb_snapshot {
     nuraft::ptr<nuraft::snapshot> snapshot_;
 };
 
+// State carried across `read_logical_snp_obj` calls for one snapshot
+// transfer. Object 0 carries no data, object 1 starts at the smallest key,
+// and object `i > 1` holds the key-value pairs that follow
+// `resume_after_[i]`, so that a retransmitted object can be rebuilt.
+struct splinterdb_snapshot_reader {
+    std::map<nuraft::ulong, std::string> resume_after_;
+
+    // Encoding buffer reused across objects.
+    std::string scratch_;
+};
+
 }  // namespace replicated_splinterdb
 
-#endif  // REPLICATED_SPLINTERDB_SPLINTERDB_SNAPSHOT_H
\ No newline at end of file
+#endif  // REPLICATED_SPLINTERDB_SPLINTERDB_SNAPSHOT_H
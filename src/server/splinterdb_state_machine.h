@@ -1,9 +1,13 @@
 #ifndef REPLICATED_SPLINTERDB_SPLINTERDB_STATE_MACHINE_H
 #define REPLICATED_SPLINTERDB_SPLINTERDB_STATE_MACHINE_H
 
+#include <chrono>
+#include <condition_variable>
 #include <map>
+#include <unordered_map>
 
 #include "libnuraft/nuraft.hxx"
+#include "replicated-splinterdb/server/splinterdb_operation.h"
 #include "replicated-splinterdb/server/splinterdb_wrapper.h"
 #include "splinterdb_snapshot.h"
 
@@ -19,8 +23,18 @@ class splinterdb_state_machine : public nuraft::state_machine {
     splinterdb_state_machine& operator=(const splinterdb_state_machine&) =
         delete;
 
+    /**
+     * @param config SplinterDB configuration.
+     * @param open_existing Reopen the SplinterDB file of an earlier run
+     *                      instead of creating a new one, and resume from
+     *                      the last log and snapshot it recorded.
+     * @param disable_snapshots Never create snapshots.
+     * @param snapshot_obj_size Soft limit on the size of a snapshot object.
+     */
     explicit splinterdb_state_machine(const splinterdb_config& config,
-                                      bool disable_snapshots = false);
+                                      bool open_existing = false,
+                                      bool disable_snapshots = false,
+                                      size_t snapshot_obj_size = 1024 * 1024);
 
     ~splinterdb_state_machine() override;
 
@@ -150,6 +164,16 @@ class splinterdb_state_machine : public nuraft::state_machine {
      */
     nuraft::ulong last_commit_index() override;
 
+    /**
+     * Wait until the given log has been committed.
+     *
+     * @param log_idx Raft log number to wait for.
+     * @param timeout Maximum time to wait.
+     * @return `true` if the log was committed within `timeout`.
+     */
+    bool wait_for_commit(nuraft::ulong log_idx,
+                         std::chrono::milliseconds timeout);
+
     /**
      * Create a snapshot corresponding to the given info.
      *
@@ -180,13 +204,50 @@ class splinterdb_state_machine : public nuraft::state_machine {
     }
 
   private:
+    // Apply a single operation to SplinterDB and return its return code.
+    int32_t apply(const splinterdb_operation_view& op);
+
+    // Get the result buffer holding `ret_code`.
+    nuraft::ptr<nuraft::buffer> result_buffer(int32_t ret_code);
+
+    // Register the calling thread with SplinterDB unless it already is.
+    void register_thread_once();
+
+    // Publish the last committed log and wake up `wait_for_commit` callers.
+    void set_last_committed(nuraft::ulong log_idx);
+
+    // Record in SplinterDB that every log up to `log_idx` is applied.
+    void persist_applied(nuraft::ulong log_idx);
+
+    // Record the latest snapshot in SplinterDB.
+    void persist_snapshot(nuraft::snapshot& snp);
+
+    // Load what `persist_applied` and `persist_snapshot` recorded.
+    void recover();
+
+    // Delete every key, ahead of loading a snapshot.
+    void clear();
+
+    // Keep `snp`, evicting the oldest snapshots beyond the last 3.
+    void save_snapshot(nuraft::ptr<nuraft::snapshot>& snp);
+
     splinterdb* spl_handle_;
 
     // Last committed Raft log number.
     std::atomic<uint64_t> last_committed_idx_;
 
-    // Track whether the commit thread has been registered by splinterdb
-    std::atomic<bool> commit_thread_initialized_;
+    // Number of threads in `wait_for_commit`, so commits only take
+    // `commit_lock_` when someone is waiting.
+    std::atomic<size_t> commit_waiters_;
+
+    std::mutex commit_lock_;
+
+    // Signalled when `last_committed_idx_` advances and there are waiters.
+    std::condition_variable commit_cv_;
+
+    // Shared, read-only result buffers by return code. Only touched by the
+    // commit thread.
+    std::unordered_map<int32_t, nuraft::ptr<nuraft::buffer>> result_buffers_;
 
     // Keeps the last 3 snapshots, by their Raft log numbers.
     std::map<uint64_t, nuraft::ptr<splinterdb_snapshot>> snapshots_;
@@ -195,6 +256,9 @@ class splinterdb_state_machine : public nuraft::state_machine {
     std::mutex snapshots_lock_;
 
     bool disable_snapshots_;
+
+    // Soft limit on the uncompressed size of a logical snapshot object.
+    size_t snapshot_obj_size_;
 };
 
 }  // namespace replicated_splinterdb
@@ -0,0 +1,181 @@
+#include <atomic>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "in_memory_log_store.h"
+#include "libnuraft/nuraft.hxx"
+#include "test_common.h"
+
+using namespace replicated_splinterdb::test;
+using nuraft::buffer;
+using nuraft::buffer_serializer;
+using nuraft::cs_new;
+using nuraft::inmem_log_store;
+using nuraft::log_entry;
+using nuraft::ptr;
+using nuraft::ulong;
+
+// More than the ring starts out with, so that it has to grow.
+static constexpr size_t MANY_LOGS = 10000;
+
+static ptr<log_entry> make_entry(ulong term, uint64_t payload) {
+    ptr<buffer> buf = buffer::alloc(sizeof(uint64_t));
+    buffer_serializer bs(buf);
+    bs.put_u64(payload);
+    return cs_new<log_entry>(term, buf);
+}
+
+static uint64_t payload_of(const ptr<log_entry>& le) {
+    buffer_serializer bs(le->get_buf());
+    return bs.get_u64();
+}
+
+// Append entries whose term and payload are both their index.
+static void append_n(inmem_log_store& store, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        ptr<log_entry> le = make_entry(store.next_slot(), store.next_slot());
+        store.append(le);
+    }
+}
+
+static void ring_grows_and_keeps_logs() {
+    inmem_log_store store;
+    CHECK(store.start_index() == 1);
+    CHECK(store.next_slot() == 1);
+    CHECK(store.last_entry()->get_term() == 0);
+
+    append_n(store, MANY_LOGS);
+    CHECK(store.next_slot() == MANY_LOGS + 1);
+    CHECK(store.last_entry()->get_term() == MANY_LOGS);
+    for (ulong i = 1; i <= MANY_LOGS; ++i) {
+        CHECK(store.term_at(i) == i);
+    }
+    CHECK(payload_of(store.entry_at(4321)) == 4321);
+
+    auto range = store.log_entries(100, 200);
+    CHECK(range->size() == 100);
+    for (size_t i = 0; i < range->size(); ++i) {
+        CHECK((*range)[i]->get_term() == 100 + i);
+    }
+
+    // Outside the log, a dummy entry stands in.
+    CHECK(store.entry_at(MANY_LOGS + 1)->get_term() == 0);
+}
+
+static void write_at_and_compact() {
+    inmem_log_store store;
+    append_n(store, 100);
+
+    ptr<log_entry> le = make_entry(999, 50);
+    store.write_at(50, le);
+    CHECK(store.next_slot() == 51);
+    CHECK(store.term_at(50) == 999);
+    CHECK(store.term_at(49) == 49);
+
+    CHECK(store.compact(20));
+    CHECK(store.start_index() == 21);
+    CHECK(store.term_at(21) == 21);
+    CHECK(store.entry_at(20)->get_term() == 0);
+
+    // Compacting past the end moves the next slot along with the start.
+    CHECK(store.compact(200));
+    CHECK(store.start_index() == 201);
+    CHECK(store.next_slot() == 201);
+    append_n(store, 1);
+    CHECK(store.term_at(201) == 201);
+}
+
+static void pack_round_trip() {
+    inmem_log_store source;
+    append_n(source, 50);
+    ptr<buffer> pack = source.pack(11, 30);
+
+    inmem_log_store dest;
+    append_n(dest, 20);
+    dest.apply_pack(11, *pack);
+    CHECK(dest.next_slot() == 41);
+    for (ulong i = 1; i <= 40; ++i) {
+        CHECK(dest.term_at(i) == i);
+        CHECK(payload_of(dest.entry_at(i)) == i);
+    }
+}
+
+static void readers_get_their_own_copies() {
+    inmem_log_store store;
+    append_n(store, 10);
+
+    // Raft moves the read position of buffers it serializes. That must not
+    // show through to other readers of the same log.
+    ptr<log_entry> first = store.entry_at(5);
+    first->get_buf().pos(sizeof(uint64_t));
+    first->serialize();
+
+    ptr<log_entry> second = store.entry_at(5);
+    CHECK(second != first);
+    CHECK(second->get_buf().pos() == 0);
+    CHECK(payload_of(second) == 5);
+}
+
+static void reads_race_with_writes() {
+    inmem_log_store store;
+    std::atomic<bool> stop{false};
+    std::atomic<size_t> bad{0};
+
+    // Every log's term is its index, whatever truncations and compactions
+    // happen in the meantime, so readers can check what they get.
+    std::vector<std::thread> readers;
+    for (int t = 0; t < 4; ++t) {
+        readers.emplace_back([&, t] {
+            std::mt19937 rng(static_cast<unsigned>(t));
+            while (!stop.load()) {
+                ulong start = store.start_index();
+                ulong next = store.next_slot();
+                if (next <= start) {
+                    continue;
+                }
+                ulong idx = start + rng() % (next - start);
+
+                // Only single logs are read: asking for a range that is no
+                // longer in the log breaks the store's contract, and the
+                // writer below may compact it away at any time.
+                ulong term = store.entry_at(idx)->get_term();
+                if (term != 0 && term != idx) {
+                    ++bad;
+                }
+                term = store.term_at(idx);
+                if (term != 0 && term != idx) {
+                    ++bad;
+                }
+            }
+        });
+    }
+
+    for (size_t round = 0; round < 4 * MANY_LOGS; ++round) {
+        append_n(store, 1);
+        ulong next = store.next_slot();
+        if (round % 97 == 0 && next > store.start_index() + 5) {
+            ptr<log_entry> le = make_entry(next - 3, next - 3);
+            store.write_at(next - 3, le);
+        }
+        if (round % 5000 == 4999) {
+            store.compact(store.next_slot() - 100);
+        }
+    }
+
+    stop.store(true);
+    for (auto& t : readers) {
+        t.join();
+    }
+    CHECK(bad.load() == 0);
+}
+
+int main() {
+    return run_tests({
+        {"ring_grows_and_keeps_logs", ring_grows_and_keeps_logs},
+        {"write_at_and_compact", write_at_and_compact},
+        {"pack_round_trip", pack_round_trip},
+        {"readers_get_their_own_copies", readers_get_their_own_copies},
+        {"reads_race_with_writes", reads_race_with_writes},
+    });
+}
@@ -0,0 +1,83 @@
+#include <chrono>
+
+#include "replicated-splinterdb/client/latency_histogram.h"
+#include "test_common.h"
+
+using namespace replicated_splinterdb;
+using namespace replicated_splinterdb::test;
+using std::chrono::microseconds;
+using std::chrono::nanoseconds;
+
+static void empty_histogram_reports_zero() {
+    latency_histogram h;
+    CHECK(h.percentile(0.5) == microseconds(0));
+    CHECK(h.percentile(1) == microseconds(0));
+}
+
+static void buckets_bound_latencies_within_a_quarter() {
+    for (int64_t us = 1; us < 20000; ++us) {
+        latency_histogram h;
+        h.record(microseconds(us));
+        int64_t bound = h.percentile(0.5).count();
+        CHECK(bound >= us);
+        CHECK(bound <= us + us / 4 + 1);
+    }
+
+    // Below a microsecond, and nonsense negative latencies.
+    latency_histogram h;
+    h.record(nanoseconds(300));
+    h.record(nanoseconds(-5));
+    CHECK(h.percentile(1) == microseconds(1));
+}
+
+static void huge_latencies_land_in_the_last_bucket() {
+    latency_histogram h;
+    h.record(std::chrono::hours(24 * 365));
+    h.record(std::chrono::hours(24 * 365 * 100));
+    CHECK(h.percentile(0.5) > microseconds(0));
+    CHECK(h.percentile(0.5) == h.percentile(1));
+}
+
+static void percentiles_follow_the_distribution() {
+    latency_histogram h;
+    for (int i = 0; i < 900; ++i) {
+        h.record(microseconds(10));
+    }
+    for (int i = 0; i < 100; ++i) {
+        h.record(microseconds(1000));
+    }
+
+    CHECK(h.percentile(0.5) >= microseconds(10));
+    CHECK(h.percentile(0.5) <= microseconds(13));
+    CHECK(h.percentile(0.89) <= microseconds(13));
+    CHECK(h.percentile(0.95) >= microseconds(1000));
+    CHECK(h.percentile(0.95) <= microseconds(1250));
+}
+
+static void old_samples_decay() {
+    latency_histogram h(100);
+    for (int i = 0; i < 100; ++i) {
+        h.record(microseconds(1000));
+    }
+    CHECK(h.percentile(0.5) >= microseconds(1000));
+
+    // The older, slower samples are halved twice by now, and the newer ones
+    // once, so the median has moved to the newer ones.
+    for (int i = 0; i < 100; ++i) {
+        h.record(microseconds(10));
+    }
+    CHECK(h.percentile(0.5) <= microseconds(13));
+}
+
+int main() {
+    return run_tests({
+        {"empty_histogram_reports_zero", empty_histogram_reports_zero},
+        {"buckets_bound_latencies_within_a_quarter",
+         buckets_bound_latencies_within_a_quarter},
+        {"huge_latencies_land_in_the_last_bucket",
+         huge_latencies_land_in_the_last_bucket},
+        {"percentiles_follow_the_distribution",
+         percentiles_follow_the_distribution},
+        {"old_samples_decay", old_samples_decay},
+    });
+}
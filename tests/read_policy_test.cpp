@@ -0,0 +1,112 @@
+#include <map>
+#include <string>
+#include <vector>
+
+#include "replicated-splinterdb/client/read_policy.h"
+#include "test_common.h"
+
+using namespace replicated_splinterdb;
+using namespace replicated_splinterdb::test;
+
+static constexpr size_t NUM_TOKENS = 128;
+static constexpr size_t NUM_KEYS = 30000;
+
+static std::vector<std::string> make_keys() {
+    std::vector<std::string> keys;
+    keys.reserve(NUM_KEYS);
+    for (size_t i = 0; i < NUM_KEYS; ++i) {
+        keys.push_back("user" + std::to_string(i));
+    }
+    return keys;
+}
+
+static std::vector<int32_t> route_all(hash_read_policy& policy,
+                                      const std::vector<std::string>& keys) {
+    std::vector<int32_t> routes;
+    routes.reserve(keys.size());
+    for (const auto& key : keys) {
+        routes.push_back(policy.next_server(key));
+    }
+    return routes;
+}
+
+static void ring_ignores_server_order() {
+    auto keys = make_keys();
+    hash_read_policy a({1, 2, 3}, NUM_TOKENS);
+    hash_read_policy b({3, 1, 2}, NUM_TOKENS);
+    CHECK(route_all(a, keys) == route_all(b, keys));
+}
+
+static void keys_spread_across_servers() {
+    auto keys = make_keys();
+    hash_read_policy policy({1, 2, 3}, NUM_TOKENS);
+
+    std::map<int32_t, size_t> counts;
+    for (int32_t srv : route_all(policy, keys)) {
+        ++counts[srv];
+    }
+    CHECK(counts.size() == 3);
+    for (const auto& [srv, count] : counts) {
+        // A third each, give or take what 128 virtual nodes allow.
+        CHECK(count > NUM_KEYS / 5);
+        CHECK(count < NUM_KEYS / 2);
+    }
+}
+
+static void membership_change_moves_few_keys() {
+    auto keys = make_keys();
+    hash_read_policy three({1, 2, 3}, NUM_TOKENS);
+    hash_read_policy four({1, 2, 3, 4}, NUM_TOKENS);
+    auto before = route_all(three, keys);
+    auto after = route_all(four, keys);
+
+    // Only keys taken over by the new server move, about a quarter of them.
+    size_t moved = 0;
+    for (size_t i = 0; i < keys.size(); ++i) {
+        if (before[i] != after[i]) {
+            CHECK(after[i] == 4);
+            ++moved;
+        }
+    }
+    CHECK(moved > NUM_KEYS / 8);
+    CHECK(moved < NUM_KEYS * 3 / 8);
+
+    // Removing a server only moves its own keys.
+    hash_read_policy two({1, 3}, NUM_TOKENS);
+    auto removed = route_all(two, keys);
+    for (size_t i = 0; i < keys.size(); ++i) {
+        if (before[i] != 2) {
+            CHECK(removed[i] == before[i]);
+        }
+    }
+}
+
+static void alternate_is_another_stable_server() {
+    auto keys = make_keys();
+    hash_read_policy policy({1, 2, 3}, NUM_TOKENS);
+    for (size_t i = 0; i < 1000; ++i) {
+        int32_t primary = policy.next_server(keys[i]);
+        int32_t alternate = policy.alternate_server(keys[i], primary);
+        CHECK(alternate != primary);
+        CHECK(alternate == policy.alternate_server(keys[i], primary));
+    }
+
+    hash_read_policy single({7}, NUM_TOKENS);
+    CHECK(single.next_server("key") == 7);
+    CHECK(single.alternate_server("key", 7) == 7);
+}
+
+static void zero_tokens_is_rejected() {
+    CHECK_THROWS(hash_read_policy({1, 2, 3}, 0));
+}
+
+int main() {
+    return run_tests({
+        {"ring_ignores_server_order", ring_ignores_server_order},
+        {"keys_spread_across_servers", keys_spread_across_servers},
+        {"membership_change_moves_few_keys", membership_change_moves_few_keys},
+        {"alternate_is_another_stable_server",
+         alternate_is_another_stable_server},
+        {"zero_tokens_is_rejected", zero_tokens_is_rejected},
+    });
+}
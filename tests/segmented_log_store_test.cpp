@@ -0,0 +1,195 @@
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+#include "libnuraft/nuraft.hxx"
+#include "segmented_log_store.h"
+#include "test_common.h"
+
+using namespace replicated_splinterdb;
+using namespace replicated_splinterdb::test;
+using nuraft::buffer;
+using nuraft::buffer_serializer;
+using nuraft::cs_new;
+using nuraft::log_entry;
+using nuraft::ptr;
+using nuraft::ulong;
+
+// Small enough that a few dozen entries span several segments.
+static constexpr size_t SEGMENT_SIZE = 256;
+
+static ptr<log_entry> make_entry(ulong term, uint64_t payload) {
+    ptr<buffer> buf = buffer::alloc(sizeof(uint64_t));
+    buffer_serializer bs(buf);
+    bs.put_u64(payload);
+    return cs_new<log_entry>(term, buf);
+}
+
+static uint64_t payload_of(const ptr<log_entry>& le) {
+    buffer_serializer bs(le->get_buf());
+    return bs.get_u64();
+}
+
+// Append entries whose term and payload are both their index.
+static void append_n(segmented_log_store& store, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        ptr<log_entry> le = make_entry(store.next_slot(), store.next_slot());
+        store.append(le);
+    }
+}
+
+static void check_entries(segmented_log_store& store, ulong first,
+                          ulong end) {
+    for (ulong i = first; i < end; ++i) {
+        ptr<log_entry> le = store.entry_at(i);
+        CHECK(le->get_term() == i);
+        CHECK(payload_of(le) == i);
+    }
+}
+
+// The segment with the highest base index, which is the active one.
+static std::filesystem::path last_segment(const temp_dir& dir) {
+    std::filesystem::path last;
+    for (const auto& f : std::filesystem::directory_iterator(dir.path())) {
+        if (f.path().extension() == ".seg" &&
+            (last.empty() || f.path().filename() > last.filename())) {
+            last = f.path();
+        }
+    }
+    return last;
+}
+
+static void reopen_keeps_entries() {
+    temp_dir dir;
+    {
+        segmented_log_store store(dir.str(), SEGMENT_SIZE,
+                                  log_fsync_policy::always);
+        append_n(store, 40);
+    }
+
+    segmented_log_store store(dir.str(), SEGMENT_SIZE,
+                              log_fsync_policy::always);
+    CHECK(store.start_index() == 1);
+    CHECK(store.next_slot() == 41);
+    CHECK(store.last_entry()->get_term() == 40);
+    check_entries(store, 1, 41);
+    CHECK(store.log_entries(10, 30)->size() == 20);
+}
+
+static void torn_tail_is_dropped() {
+    temp_dir dir;
+    {
+        segmented_log_store store(dir.str(), SEGMENT_SIZE,
+                                  log_fsync_policy::always);
+        append_n(store, 10);
+    }
+
+    // A crash in the middle of an append leaves a partial record behind.
+    {
+        std::ofstream seg(last_segment(dir), std::ios::binary | std::ios::app);
+        seg.write("\x40\x00\x00\x00\x12\x34", 6);
+    }
+
+    {
+        segmented_log_store store(dir.str(), SEGMENT_SIZE,
+                                  log_fsync_policy::always);
+        CHECK(store.next_slot() == 11);
+        check_entries(store, 1, 11);
+        append_n(store, 1);
+    }
+
+    // A record whose checksum does not match is dropped too.
+    std::filesystem::path seg = last_segment(dir);
+    std::filesystem::resize_file(seg, std::filesystem::file_size(seg) - 1);
+
+    segmented_log_store store(dir.str(), SEGMENT_SIZE,
+                              log_fsync_policy::always);
+    CHECK(store.next_slot() == 11);
+    check_entries(store, 1, 11);
+}
+
+static void write_at_truncates_across_reopen() {
+    temp_dir dir;
+    {
+        segmented_log_store store(dir.str(), SEGMENT_SIZE,
+                                  log_fsync_policy::always);
+        append_n(store, 30);
+        ptr<log_entry> le = make_entry(99, 5);
+        store.write_at(5, le);
+        CHECK(store.next_slot() == 6);
+    }
+
+    segmented_log_store store(dir.str(), SEGMENT_SIZE,
+                              log_fsync_policy::always);
+    CHECK(store.next_slot() == 6);
+    CHECK(store.term_at(5) == 99);
+    check_entries(store, 1, 5);
+}
+
+static void compaction_survives_reopen() {
+    temp_dir dir;
+    {
+        segmented_log_store store(dir.str(), SEGMENT_SIZE,
+                                  log_fsync_policy::always);
+        append_n(store, 40);
+        CHECK(store.compact(25));
+        CHECK(store.start_index() == 26);
+    }
+
+    segmented_log_store store(dir.str(), SEGMENT_SIZE,
+                              log_fsync_policy::always);
+    CHECK(store.start_index() == 26);
+    CHECK(store.next_slot() == 41);
+    check_entries(store, 26, 41);
+}
+
+static void interrupted_reset_restarts_log() {
+    // Compacting past the end of the log saves the new start, then replaces
+    // the segments with an empty one. Put a start saved that way next to
+    // the old segments, as if the process had died in between.
+    temp_dir reset_dir;
+    {
+        segmented_log_store store(reset_dir.str(), SEGMENT_SIZE,
+                                  log_fsync_policy::always);
+        append_n(store, 5);
+        CHECK(store.compact(50));
+    }
+
+    temp_dir dir;
+    {
+        segmented_log_store store(dir.str(), SEGMENT_SIZE,
+                                  log_fsync_policy::always);
+        append_n(store, 5);
+    }
+    std::filesystem::copy_file(
+        reset_dir.path() / "start", dir.path() / "start",
+        std::filesystem::copy_options::overwrite_existing);
+
+    segmented_log_store store(dir.str(), SEGMENT_SIZE,
+                              log_fsync_policy::always);
+    CHECK(store.start_index() == 51);
+    CHECK(store.next_slot() == 51);
+    append_n(store, 1);
+    CHECK(store.entry_at(51)->get_term() == 51);
+}
+
+static void group_commit_makes_appends_durable() {
+    temp_dir dir;
+    segmented_log_store store(dir.str(), SEGMENT_SIZE,
+                              log_fsync_policy::group_commit);
+    append_n(store, 20);
+    CHECK(store.flush());
+    CHECK(store.last_durable_index() == 20);
+}
+
+int main() {
+    return run_tests({
+        {"reopen_keeps_entries", reopen_keeps_entries},
+        {"torn_tail_is_dropped", torn_tail_is_dropped},
+        {"write_at_truncates_across_reopen", write_at_truncates_across_reopen},
+        {"compaction_survives_reopen", compaction_survives_reopen},
+        {"interrupted_reset_restarts_log", interrupted_reset_restarts_log},
+        {"group_commit_makes_appends_durable",
+         group_commit_makes_appends_durable},
+    });
+}
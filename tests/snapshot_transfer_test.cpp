@@ -0,0 +1,167 @@
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "libnuraft/nuraft.hxx"
+#include "replicated-splinterdb/server/splinterdb_operation.h"
+#include "splinterdb_state_machine.h"
+#include "test_common.h"
+
+using namespace replicated_splinterdb;
+using namespace replicated_splinterdb::test;
+using nuraft::buffer;
+using nuraft::cluster_config;
+using nuraft::cs_new;
+using nuraft::ptr;
+using nuraft::snapshot;
+using nuraft::ulong;
+
+static constexpr size_t NUM_KEYS = 2000;
+static constexpr size_t VALUE_SIZE = 100;
+// Small enough that the snapshot takes many objects.
+static constexpr size_t OBJ_SIZE = 4096;
+
+static std::string key_of(size_t i) {
+    char key[16];
+    std::snprintf(key, sizeof(key), "key-%05zu", i);
+    return key;
+}
+
+static std::string value_of(size_t i) {
+    return std::string(VALUE_SIZE, static_cast<char>('a' + i % 26));
+}
+
+// Configuration of a SplinterDB file in the test's directory. SplinterDB
+// keeps a pointer to the data config, so this must outlive the instance.
+class test_db {
+  public:
+    test_db(const temp_dir& dir, const std::string& name)
+        : filename_((dir.path() / name).string()) {
+        default_data_config_init(64, &data_cfg_);
+        std::memset(&cfg_, 0, sizeof(cfg_));
+        cfg_.filename = filename_.c_str();
+        cfg_.disk_size = 256 * 1024 * 1024;
+        cfg_.cache_size = 64 * 1024 * 1024;
+        cfg_.data_cfg = &data_cfg_;
+    }
+
+    std::unique_ptr<splinterdb_state_machine> open() const {
+        return std::make_unique<splinterdb_state_machine>(cfg_, false, false,
+                                                          OBJ_SIZE);
+    }
+
+  private:
+    std::string filename_;
+    data_config data_cfg_;
+    splinterdb_config cfg_;
+};
+
+static void commit_put(splinterdb_state_machine& sm, ulong log_idx,
+                       std::string key, std::string value) {
+    ptr<buffer> payload =
+        splinterdb_operation::make_put(std::move(key), std::move(value))
+            .serialize();
+    sm.commit(log_idx, *payload);
+}
+
+static bool lookup(splinterdb_state_machine& sm, const std::string& key,
+                   std::string& value) {
+    splinterdb* handle = sm.get_splinterdb_handle();
+    splinterdb_lookup_result result;
+    splinterdb_lookup_result_init(handle, &result, 0, nullptr);
+
+    bool found = false;
+    if (splinterdb_lookup(handle, slice_create(key.size(), key.data()),
+                          &result) == 0 &&
+        splinterdb_lookup_found(&result)) {
+        slice val;
+        splinterdb_lookup_result_value(&result, &val);
+        value.assign(static_cast<const char*>(val.data), val.length);
+        found = true;
+    }
+
+    splinterdb_lookup_result_deinit(&result);
+    return found;
+}
+
+static bool same_bytes(const buffer& a, const buffer& b) {
+    return a.size() == b.size() &&
+           std::memcmp(a.data_begin(), b.data_begin(), a.size()) == 0;
+}
+
+static void snapshot_is_chunked_and_resumable() {
+    temp_dir dir;
+    ptr<snapshot> snp =
+        cs_new<snapshot>(NUM_KEYS, 1, cs_new<cluster_config>());
+
+    // Read the whole snapshot from the leader, asking for one object twice
+    // as if its first transfer had been lost. Only one instance is open at
+    // a time.
+    std::vector<ptr<buffer>> objects;
+    test_db leader_db(dir, "leader.db");
+    {
+        auto leader = leader_db.open();
+        for (size_t i = 0; i < NUM_KEYS; ++i) {
+            commit_put(*leader, i + 1, key_of(i), value_of(i));
+        }
+
+        void* ctx = nullptr;
+        bool is_last = false;
+        for (ulong obj_id = 0; !is_last; ++obj_id) {
+            ptr<buffer> data;
+            CHECK(leader->read_logical_snp_obj(*snp, ctx, obj_id, data,
+                                               is_last) == 0);
+            CHECK(data->size() <= OBJ_SIZE + 64);
+
+            if (obj_id == 3) {
+                ptr<buffer> again;
+                bool again_last = false;
+                CHECK(leader->read_logical_snp_obj(*snp, ctx, obj_id, again,
+                                                   again_last) == 0);
+                CHECK(same_bytes(*data, *again));
+                CHECK(again_last == is_last);
+            }
+            objects.push_back(data);
+        }
+
+        // Objects are only served in order.
+        ptr<buffer> data;
+        CHECK(leader->read_logical_snp_obj(*snp, ctx, objects.size() + 5,
+                                           data, is_last) != 0);
+        leader->free_user_snp_ctx(ctx);
+        CHECK(ctx == nullptr);
+    }
+    CHECK(objects.size() > 10);
+
+    test_db follower_db(dir, "follower.db");
+    auto follower = follower_db.open();
+    // State from before the snapshot must not survive it.
+    commit_put(*follower, 1, "stale", "value");
+
+    ulong obj_id = 0;
+    for (size_t i = 0; i < objects.size(); ++i) {
+        ulong expected = obj_id + 1;
+        follower->save_logical_snp_obj(*snp, obj_id, *objects[i], i == 0,
+                                       i + 1 == objects.size());
+        CHECK(obj_id == expected);
+    }
+    CHECK(follower->apply_snapshot(*snp));
+    CHECK(follower->last_commit_index() == NUM_KEYS);
+    CHECK(follower->last_snapshot()->get_last_log_idx() == NUM_KEYS);
+
+    std::string value;
+    CHECK(!lookup(*follower, "stale", value));
+    for (size_t i = 0; i < NUM_KEYS; ++i) {
+        CHECK(lookup(*follower, key_of(i), value));
+        CHECK(value == value_of(i));
+    }
+}
+
+int main() {
+    return run_tests({
+        {"snapshot_is_chunked_and_resumable",
+         snapshot_is_chunked_and_resumable},
+    });
+}
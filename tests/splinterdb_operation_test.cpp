@@ -0,0 +1,185 @@
+#include <random>
+#include <string>
+#include <vector>
+
+#include "libnuraft/nuraft.hxx"
+#include "replicated-splinterdb/server/splinterdb_operation.h"
+#include "test_common.h"
+
+using namespace replicated_splinterdb;
+using namespace replicated_splinterdb::test;
+using nuraft::buffer;
+using nuraft::buffer_serializer;
+using nuraft::ptr;
+
+using op = splinterdb_operation;
+using op_view = splinterdb_operation_view;
+
+// First byte of a payload in the v1 format.
+static constexpr uint8_t FORMAT_V1 = 0x81;
+
+static std::string random_bytes(size_t size) {
+    std::mt19937 rng(42);
+    std::string s(size, '\0');
+    for (char& c : s) {
+        c = static_cast<char>(rng());
+    }
+    return s;
+}
+
+// Check that `payload` decodes, both owning and as a view, to a single
+// operation with the given contents.
+static void check_decodes_to(ptr<buffer> payload,
+                             op::splinterdb_operation_type type,
+                             const std::string& key,
+                             const std::string& value) {
+    op decoded = op::deserialize(*payload);
+    CHECK(decoded.type() == type);
+    CHECK(decoded.key() == key);
+    if (type != op::DELETE) {
+        CHECK(decoded.value() == value);
+    }
+
+    op_view view = op_view::decode(*payload);
+    CHECK(view.type() == type);
+    CHECK(view.key() == key);
+    CHECK(view.value() == (type == op::DELETE ? "" : value));
+}
+
+static void put_and_delete_round_trip() {
+    ptr<buffer> put = op::make_put("key", "value").serialize();
+    CHECK(put->data_begin()[0] == FORMAT_V1);
+    check_decodes_to(put, op::PUT, "key", "value");
+
+    check_decodes_to(op::make_delete("gone").serialize(), op::DELETE, "gone",
+                     "");
+
+    // Lengths past one varint byte, and empty keys and values.
+    std::string long_key(300, 'k');
+    std::string long_value = random_bytes(70000);
+    check_decodes_to(op::make_put(std::string(long_key),
+                                  std::string(long_value))
+                         .serialize(),
+                     op::PUT, long_key, long_value);
+    check_decodes_to(op::make_put("", "").serialize(), op::PUT, "", "");
+}
+
+static void values_are_compressed_when_smaller() {
+    std::string repetitive(4096, 'a');
+    ptr<buffer> compressed =
+        op::make_put("key", std::string(repetitive)).serialize(64);
+    CHECK(compressed->size() < repetitive.size() / 4);
+    check_decodes_to(compressed, op::PUT, "key", repetitive);
+
+    // Below the threshold, or when compression does not help, the value
+    // is stored as-is.
+    ptr<buffer> small = op::make_put("key", std::string(repetitive))
+                            .serialize(repetitive.size() + 1);
+    CHECK(small->size() > repetitive.size());
+    check_decodes_to(small, op::PUT, "key", repetitive);
+
+    std::string noise = random_bytes(4096);
+    ptr<buffer> incompressible =
+        op::make_put("key", std::string(noise)).serialize(64);
+    CHECK(incompressible->size() > noise.size());
+    check_decodes_to(incompressible, op::PUT, "key", noise);
+}
+
+static void batch_round_trip() {
+    std::vector<op> ops;
+    ops.push_back(op::make_put("a", "1"));
+    ops.push_back(op::make_delete("b"));
+    ops.push_back(op::make_put("c", std::string(1000, 'c')));
+    ptr<buffer> payload = op::make_batch(std::move(ops)).serialize(64);
+
+    op decoded = op::deserialize(*payload);
+    CHECK(decoded.type() == op::BATCH);
+    CHECK(decoded.batch().size() == 3);
+    CHECK(decoded.batch()[0].type() == op::PUT);
+    CHECK(decoded.batch()[0].key() == "a");
+    CHECK(decoded.batch()[0].value() == "1");
+    CHECK(decoded.batch()[1].type() == op::DELETE);
+    CHECK(decoded.batch()[1].key() == "b");
+    CHECK(decoded.batch()[2].value() == std::string(1000, 'c'));
+
+    op_view view = op_view::decode(*payload);
+    CHECK(view.type() == op::BATCH);
+    CHECK(view.batch().size() == 3);
+    CHECK(view.batch()[0].key() == "a");
+    CHECK(view.batch()[1].type() == op::DELETE);
+    CHECK(view.batch()[2].value() == std::string(1000, 'c'));
+}
+
+static void updates_cannot_be_logged() {
+    CHECK_THROWS(op::make_update("key", "delta").serialize());
+
+    std::vector<op> ops;
+    ops.push_back(op::make_update("key", "delta"));
+    CHECK_THROWS(op::make_batch(std::move(ops)).serialize());
+}
+
+// The original format: the type, then 32-bit length prefixed strings.
+static ptr<buffer> legacy_payload(op::splinterdb_operation_type type,
+                                  const std::string& key,
+                                  const std::string* value) {
+    size_t size = 1 + 4 + key.size() + (value ? 4 + value->size() : 0);
+    ptr<buffer> buf = buffer::alloc(size);
+    buffer_serializer bs(buf);
+    bs.put_u8(type);
+    bs.put_str(key);
+    if (value != nullptr) {
+        bs.put_str(*value);
+    }
+    return buf;
+}
+
+static void legacy_payloads_decode() {
+    std::string value = "value";
+    check_decodes_to(legacy_payload(op::PUT, "key", &value), op::PUT, "key",
+                     value);
+    check_decodes_to(legacy_payload(op::UPDATE, "key", &value), op::UPDATE,
+                     "key", value);
+    check_decodes_to(legacy_payload(op::DELETE, "key", nullptr), op::DELETE,
+                     "key", "");
+}
+
+static ptr<buffer> raw_payload(const std::vector<uint8_t>& bytes) {
+    ptr<buffer> buf = buffer::alloc(bytes.size());
+    buffer_serializer bs(buf);
+    bs.put_raw(bytes.data(), bytes.size());
+    return buf;
+}
+
+static void malformed_payloads_are_rejected() {
+    std::vector<ptr<buffer>> bad = {
+        // Unknown format version.
+        raw_payload({0x82, op::PUT, 0, 0, 0}),
+        // A batch holding a batch.
+        raw_payload({FORMAT_V1, op::BATCH, 0, 1, op::BATCH, 0, 0}),
+        // A batch claiming far more operations than the payload holds.
+        raw_payload({FORMAT_V1, op::BATCH, 0, 0xff, 0xff, 0xff, 0xff, 0x0f}),
+        // A key running past the end.
+        raw_payload({FORMAT_V1, op::DELETE, 0, 10, 'a'}),
+        // A compressed value that does not inflate.
+        raw_payload({FORMAT_V1, op::PUT, 1, 1, 'k', 4, 2, 'x', 'y'}),
+    };
+
+    for (const auto& payload : bad) {
+        CHECK_THROWS(op::deserialize(*payload));
+        CHECK_THROWS(op_view::decode(*payload));
+    }
+
+    CHECK_THROWS(op::deserialize(*buffer::alloc(0)));
+}
+
+int main() {
+    return run_tests({
+        {"put_and_delete_round_trip", put_and_delete_round_trip},
+        {"values_are_compressed_when_smaller",
+         values_are_compressed_when_smaller},
+        {"batch_round_trip", batch_round_trip},
+        {"updates_cannot_be_logged", updates_cannot_be_logged},
+        {"legacy_payloads_decode", legacy_payloads_decode},
+        {"malformed_payloads_are_rejected", malformed_payloads_are_rejected},
+    });
+}
@@ -0,0 +1,95 @@
+#ifndef REPLICATED_SPLINTERDB_TESTS_TEST_COMMON_H
+#define REPLICATED_SPLINTERDB_TESTS_TEST_COMMON_H
+
+#include <cstdlib>
+#include <exception>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Checks stay on in release builds, unlike `assert`.
+#define CHECK(cond)                                                 \
+    do {                                                            \
+        if (!(cond)) {                                              \
+            ::replicated_splinterdb::test::fail(__FILE__, __LINE__, \
+                                                #cond);             \
+        }                                                           \
+    } while (0)
+
+#define CHECK_THROWS(expr)                                               \
+    do {                                                                 \
+        bool threw = false;                                              \
+        try {                                                            \
+            (void)(expr);                                                \
+        } catch (const std::exception&) {                                \
+            threw = true;                                                \
+        }                                                                \
+        if (!threw) {                                                    \
+            ::replicated_splinterdb::test::fail(__FILE__, __LINE__,      \
+                                                #expr " did not throw"); \
+        }                                                                \
+    } while (0)
+
+namespace replicated_splinterdb::test {
+
+[[noreturn]] inline void fail(const char* file, int line,
+                              const std::string& what) {
+    std::cerr << file << ":" << line << ": CHECK failed: " << what
+              << std::endl;
+    std::exit(1);
+}
+
+// A fresh directory under the system temporary directory, removed with
+// everything in it when the object is destroyed.
+class temp_dir {
+  public:
+    temp_dir() {
+        std::random_device rd;
+        path_ = std::filesystem::temp_directory_path() /
+                ("rsdb-test-" + std::to_string(rd()));
+        std::filesystem::create_directories(path_);
+    }
+
+    temp_dir(const temp_dir&) = delete;
+
+    temp_dir& operator=(const temp_dir&) = delete;
+
+    ~temp_dir() {
+        std::error_code ec;
+        std::filesystem::remove_all(path_, ec);
+    }
+
+    const std::filesystem::path& path() const { return path_; }
+
+    std::string str() const { return path_.string(); }
+
+  private:
+    std::filesystem::path path_;
+};
+
+using test_case = std::pair<const char*, std::function<void()>>;
+
+// Run the tests in order and return the process exit code. A test fails by
+// failing a check or throwing.
+inline int run_tests(const std::vector<test_case>& tests) {
+    for (const auto& [name, fn] : tests) {
+        std::cout << "[ RUN  ] " << name << std::endl;
+        try {
+            fn();
+        } catch (const std::exception& e) {
+            std::cerr << "[ FAIL ] " << name << ": " << e.what()
+                      << std::endl;
+            return 1;
+        }
+        std::cout << "[  OK  ] " << name << std::endl;
+    }
+    return 0;
+}
+
+}  // namespace replicated_splinterdb::test
+
+#endif  // REPLICATED_SPLINTERDB_TESTS_TEST_COMMON_H